@@ -0,0 +1,75 @@
+#---------------------------------------------------------------------------------
+# Headless Linux build against the host backend in src/host (see src/host/host.h)
+#
+#   make -f host.mk [CONFIG=HostRelease] [DEFINES="-DTARGET_HOST=1 -DDEBUG=0"]
+#   ./HostRelease/oiram -d <dir with OiramS/OiramT/packs .8xv> [-k keys.txt] [-t seconds]
+#   make -f host.mk bench BENCH_DATA=<dir> [BENCH_FRAMES=600] [BENCH_PACK=OiramPK]
+#---------------------------------------------------------------------------------
+.SUFFIXES:
+
+CONFIG		?=	HostRelease
+DEFINES		?=	-DTARGET_HOST=1 -DDEBUG=0
+BUILD		:=	$(CONFIG)
+TARGET		:=	$(BUILD)/oiram
+
+BENCH_DATA	?=	.
+BENCH_FRAMES	?=	600
+BENCH_PACK	?=	OiramPK
+
+SOURCES		:=	src src/ce_sim src/host
+INCLUDES	:=	src src/ce_sim
+
+OPTIMIZATION = -O2
+
+CBASEFLAGS	= $(OPTIMIZATION) \
+		  -Wall \
+		  -funroll-loops \
+		  -fno-trapping-math \
+		  -fno-trapv \
+		  -Wno-switch \
+		  -Wno-stringop-truncation \
+		  -Wno-narrowing \
+		  -Wno-format-overflow \
+		  -MMD \
+		  $(foreach dir,$(INCLUDES), -iquote $(dir)) $(DEFINES)
+
+CFLAGS	=	$(CBASEFLAGS) \
+		  -std=c99
+
+CXXFLAGS	=  $(CBASEFLAGS) \
+		  -fpermissive \
+		  -fno-rtti \
+		  -fno-exceptions \
+		  -Wno-class-memaccess \
+		  -std=c++11
+
+CFILES		:=	$(foreach dir,$(SOURCES),$(wildcard $(dir)/*.c))
+CPPFILES	:=	$(foreach dir,$(SOURCES),$(wildcard $(dir)/*.cpp))
+OFILES		:=	$(addprefix $(BUILD)/,$(notdir $(CFILES:.c=.o) $(CPPFILES:.cpp=.o)))
+
+VPATH		:=	$(SOURCES)
+
+.PHONY: all bench clean
+.DEFAULT_GOAL := all
+
+all: $(TARGET)
+
+$(TARGET): $(OFILES)
+	$(CXX) $(OPTIMIZATION) -o $@ $^
+
+bench: $(TARGET)
+	$(TARGET) -d $(BENCH_DATA) -b $(BENCH_FRAMES) -P $(BENCH_PACK)
+
+$(BUILD)/%.o: %.c | $(BUILD)
+	$(CC) $(CFLAGS) -c $< -o $@
+
+$(BUILD)/%.o: %.cpp | $(BUILD)
+	$(CXX) $(CXXFLAGS) -c $< -o $@
+
+$(BUILD):
+	mkdir -p $@
+
+clean:
+	rm -rf $(BUILD)
+
+-include $(OFILES:.o=.d)
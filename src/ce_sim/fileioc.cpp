@@ -4,7 +4,9 @@
 #include "ce_sim.h"
 #include "fileioc.h"
 
+#if !TARGET_HOST
 #include "fxcg/file.h"
+#endif
 
 // TI file format borrowed from https://github.com/calc84maniac/tiboyce/blob/master/tiboyce-romgen/romgen.c
 enum VAR_TYPE {
@@ -233,7 +235,8 @@ ti_var_t ti_Open(const char *name, const char *mode, int readSize) {
 				Bfile_DeleteEntry(fileName);
 			}
 
-			int result = Bfile_CreateEntry_OS(fileName, CREATEMODE_FILE, (size_t*) &readSize);
+			size_t createSize = readSize;
+			int result = Bfile_CreateEntry_OS(fileName, CREATEMODE_FILE, &createSize);
 			if (result != 0) {
 				return 0;
 			}
@@ -325,6 +328,11 @@ int ti_Rewind(const ti_var_t slot) {
 	return 0;
 }
 
+uint16_t ti_GetSize(const ti_var_t slot) {
+	CEFileSlot& fileSlot = AllFiles[slot - 1];
+	return fileSlot.file.data.var_length;
+}
+
 struct foundFile {
 	char path[256];
 };
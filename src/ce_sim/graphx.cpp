@@ -5,9 +5,11 @@
 #include "graphx.h"
 #include "keypadc.h"
 
+#if !TARGET_HOST
 #include "calctype/fonts/arial_small/arial_small.h"
 
 #include "fxcg/display.h"
+#endif
 
 // the back buffer exits in VRAM area on the calculator and we use DMA to blit it, but
 // we need an extra buffer for the simulator since it doesn't use DMA
@@ -20,6 +22,18 @@ static uint16_t* BackBuffer() {
 #endif
 }
 
+// Prizm port: the 8 bit back buffer used instead while gfx_SetIndexedBuffer is on, resolved through
+// the palette as it is blitted. On the calculator it takes the start of VRAM, with the strip the
+// blit resolves into right after it
+static uint8_t* IndexBuffer() {
+#if TARGET_PRIZM
+	return (uint8_t*) GetVRAMAddress();
+#else
+	static uint8_t StaticBuffer[gfx_lcdWidth*gfx_lcdHeight];
+	return StaticBuffer;
+#endif
+}
+
 #if TARGET_PRIZM
 #define LCD_GRAM	0x202
 #define LCD_BASE	0xB4000000
@@ -62,6 +76,142 @@ static inline void DmaDrawStrip(void* srcAddress, unsigned int size) {
 }
 #endif
 
+// Prizm port: lines sent to the display in one transfer, small enough that drawing over the top of
+// a blit only waits for its first strips
+static const int StripLines = 16;
+
+// Prizm port: sends strips of RGB565 lines to the display while the CPU carries on. One strip is in
+// flight at a time, Send waits for everything sent before and Wait for the last strip, and a
+// strip's source must not change until then. Back buffer lines are queued and go a strip at a
+// time: each fence starts the next strip once the one in flight is done, and drawing over queued
+// lines sends the strips up to them first. The simulator and host have no DMA, so there a strip
+// is copied to the display when it is waited on, which keeps the same rule.
+struct BlitEngine {
+	bool bPending = false;
+
+	// back buffer lines in flight or queued, drawing over them has to wait
+	int FenceY1 = 0;
+	int FenceY2 = 0;
+
+	// back buffer lines still to be sent after the strip in flight
+	const uint16_t* QueueSource = nullptr;
+	int QueueY = 0;
+	int QueueEnd = 0;
+
+#if !TARGET_PRIZM
+	const uint16_t* Source;
+	int Y;
+	int Lines;
+#endif
+
+	void Send(const uint16_t* source, int y, int lines, bool bFromBackBuffer) {
+		Wait();
+
+		if (bFromBackBuffer) {
+			QueueSource = source;
+			QueueY = y;
+			QueueEnd = y + lines;
+			FenceY2 = QueueEnd;
+			SendNextStrip();
+		} else {
+			FenceY1 = FenceY2 = y;
+			StartStrip(source, y, lines);
+		}
+	}
+
+	void SendNextStrip() {
+		int lines = min(StripLines, QueueEnd - QueueY);
+		FenceY1 = QueueY;
+		StartStrip(QueueSource, QueueY, lines);
+		QueueSource += lines * gfx_lcdWidth;
+		QueueY += lines;
+	}
+
+	void StartStrip(const uint16_t* source, int y, int lines) {
+#if TARGET_PRIZM
+		const int ScreenOffset = (396 - gfx_lcdWidth) / 2;
+		Bdisp_WriteDDRegister3_bit7(1);
+		Bdisp_DefineDMARange(ScreenOffset, ScreenOffset + gfx_lcdWidth - 1, y, y+lines);
+		Bdisp_DDRegisterSelect(LCD_GRAM);
+
+		DmaDrawStrip((void*) source, lines * gfx_lcdWidth * 2);
+#else
+		Source = source;
+		Y = y;
+		Lines = lines;
+#endif
+		bPending = true;
+	}
+
+	bool StripDone() const {
+#if TARGET_PRIZM
+		return !bPending || ((*DMA0_DMAOR) & 4) || ((*DMA0_CHCR_0) & 2);
+#else
+		return true;
+#endif
+	}
+
+	void WaitStrip() {
+#if TARGET_PRIZM
+		DmaWaitNext();
+#endif
+
+		if (!bPending)
+			return;
+		bPending = false;
+
+#if TARGET_WINSIM
+		const int ScreenOffset = (LCD_WIDTH_PX - gfx_lcdWidth) / 2;
+		int h = min(LCD_HEIGHT_PX, Y + Lines) - Y;
+		if (h > 0) {
+			const uint16_t* SourceAddr = Source;
+			uint16_t* TargetAddr = ((uint16_t*)GetVRAMAddress()) + ScreenOffset + LCD_WIDTH_PX * Y;
+			for (int32 i = 0; i < h; i++, TargetAddr += LCD_WIDTH_PX, SourceAddr += gfx_lcdWidth) {
+				memcpy(TargetAddr, SourceAddr, gfx_lcdWidth * 2);
+			}
+			Bdisp_PutDisp_DD();
+		}
+#endif
+
+#if TARGET_HOST
+		int h = min(HOST_DISPLAY_HEIGHT, Y + Lines) - Y;
+		if (h > 0) {
+			memcpy(Host_GetDisplay() + HOST_DISPLAY_WIDTH * Y, Source, h * gfx_lcdWidth * 2);
+			Host_PresentLines(Y, h);
+		}
+#endif
+	}
+
+	void Wait() {
+		WaitStrip();
+		while (QueueY < QueueEnd) {
+			SendNextStrip();
+			WaitStrip();
+		}
+		FenceY2 = FenceY1;
+	}
+
+	// called before drawing over lines y1 to y2 of the back buffer
+	void Fence(int y1, int y2) {
+		while (FenceY1 < FenceY2 && y1 < FenceY2 && FenceY1 < y2) {
+			WaitStrip();
+			if (QueueY < QueueEnd) {
+				SendNextStrip();
+			} else {
+				FenceY2 = FenceY1;
+			}
+		}
+
+		// keeps the queue moving while the CPU draws elsewhere
+		if (QueueY < QueueEnd && StripDone()) {
+			WaitStrip();
+			SendNextStrip();
+		}
+	}
+};
+
+static BlitEngine Blit;
+
 struct GraphX_Context {
 	int Clip_MinX = 0;
 	int Clip_MinY = 0;
@@ -73,6 +223,9 @@ struct GraphX_Context {
 
 	uint8_t TransparentIndex = 0;
 
+	// drawing into IndexBuffer instead of BackBuffer
+	bool bIndexed = false;
+
 	uint16_t Palette[256];
 
 	uint16_t CurColor;
@@ -125,27 +278,50 @@ struct GraphX_Context {
 	uint16_t ResolvePalette(uint8_t PaletteIndex) {
 		return Palette[PaletteIndex];
 	}
+
+	// index that resolves to black, for filling in indexed mode
+	uint8_t BlackIndex() {
+		for (int i = 0; i < 256; i++) {
+			if (!Palette[i])
+				return i;
+		}
+		return 0;
+	}
 };
 
+static GraphX_Context GFX;
+
+static inline int PixelBytes() {
+	return GFX.bIndexed ? 1 : 2;
+}
+
+// address of a pixel in whichever back buffer is in use, for code that only moves pixels around
+static inline uint8_t* GetTargetBytes(int x, int y) {
+	if (GFX.bIndexed) {
+		return IndexBuffer() + gfx_lcdWidth * y + x;
+	}
+	return (uint8_t*)(BackBuffer() + gfx_lcdWidth * y + x);
+}
+
 #if TARGET_WINSIM
 struct ClipChecker {
 	uint16_t hashTop;
 	uint16_t hashBottom;
 
-	uint16_t Hash(uint16_t* row) {
+	uint16_t Hash(const uint8_t* row) {
 		uint16_t val = 0x1E37;
-		for (int x = 0; x < gfx_lcdWidth; x++) {
+		for (int x = 0; x < gfx_lcdWidth * PixelBytes(); x++) {
 			val = (val << 1) ^ (row[x]) ^ (val >> 15);
 		}
 		return val;
 	}
 
 	uint16_t HashTop() {
-		return Hash(BackBuffer() - gfx_lcdWidth);
+		return Hash(GetTargetBytes(0, -1));
 	}
 
 	uint16_t HashBottom() {
-		return Hash(BackBuffer() + gfx_lcdWidth * gfx_lcdHeight);
+		return Hash(GetTargetBytes(0, gfx_lcdHeight));
 	}
 
 	ClipChecker() {
@@ -164,13 +340,564 @@ struct ClipChecker {
 #define CheckClip()
 #endif
 
-static GraphX_Context GFX;
-
 uint16_t* GetTargetAddr(int x, int y) {
 	return BackBuffer() + gfx_lcdWidth * y + x;
 }
 
-template<bool bClip, bool bTransparent>
+// drawing is templated on the back buffer pixel, uint16_t for RGB565 or uint8_t for palette indices
+template<typename Pixel> Pixel* GetTarget(int x, int y);
+
+template<> inline uint16_t* GetTarget<uint16_t>(int x, int y) {
+	return GetTargetAddr(x, y);
+}
+
+template<> inline uint8_t* GetTarget<uint8_t>(int x, int y) {
+	return IndexBuffer() + gfx_lcdWidth * y + x;
+}
+
+// the pixel a palette index is drawn as
+template<typename Pixel> Pixel IndexColor(uint8_t index);
+
+template<> inline uint16_t IndexColor<uint16_t>(uint8_t index) {
+	return GFX.ResolvePalette(index);
+}
+
+template<> inline uint8_t IndexColor<uint8_t>(uint8_t index) {
+	return index;
+}
+
+// the current draw color, RGB565 colors are resolved when set
+template<typename Pixel> Pixel DrawColor();
+
+template<> inline uint16_t DrawColor<uint16_t>() {
+	return GFX.CurColor;
+}
+
+template<> inline uint8_t DrawColor<uint8_t>() {
+	return GFX.LastColorIndex;
+}
+
+// fills use 32 bit stores of two pixels, the type may alias the 16 bit back buffer
+#ifdef __GNUC__
+typedef uint32_t __attribute__((__may_alias__)) PixelPair;
+#else
+typedef uint32_t PixelPair;
+#endif
+
+// fills count pixels: one 16 bit store to reach 4 byte alignment, then pixel pairs unrolled by 4
+static inline void FillPixels(uint16_t* target, int count, uint16_t color) {
+	if (count <= 0)
+		return;
+
+	if ((uintptr_t) target & 2) {
+		*target++ = color;
+		count--;
+	}
+
+	const PixelPair pair = color | ((PixelPair) color << 16);
+	PixelPair* target32 = (PixelPair*) target;
+	for (; count >= 8; count -= 8, target32 += 4) {
+		target32[0] = pair;
+		target32[1] = pair;
+		target32[2] = pair;
+		target32[3] = pair;
+	}
+	for (; count >= 2; count -= 2) {
+		*target32++ = pair;
+	}
+
+	if (count) {
+		*(uint16_t*) target32 = color;
+	}
+}
+
+static inline void FillPixels(uint8_t* target, int count, uint8_t color) {
+	if (count > 0) {
+		memset(target, color, count);
+	}
+}
+
+// Prizm port: gfx_Tilemap keeps the back buffer from the last call and only redraws the cells
+// whose tile sprite changed, or that anything else was drawn over since, as long as the tilemap,
+// clip region and palette are unchanged. Animated tiles and map edits show up as a changed sprite.
+// When the camera moved by less than the visible area, the pixels still on screen are moved by the
+// scroll delta first and only the newly exposed cells are drawn.
+struct TilemapCache {
+	static const int MaxCols = 32;
+	static const int MaxRows = 32;
+
+	bool bEnabled = true;
+	bool bValid = false;
+
+	// state the cells were drawn with
+	gfx_tilemap_t Tilemap;
+	uint24_t XOffset;
+	uint24_t YOffset;
+	int Clip[4];
+	uint16_t Palette[256];
+
+	// grid of cells on screen, starting at map cell TileX, TileY
+	int TileX;
+	int TileY;
+	int BaseX;
+	int BaseY;
+	int NumCols;
+	int NumRows;
+
+	// sprite whose pixels each cell holds, or UnknownCell
+	gfx_sprite_t* Drawn[MaxRows][MaxCols];
+
+	void Invalidate() {
+		bValid = false;
+	}
+
+	// marks the cells under a rectangle drawn into the back buffer
+	void MarkDirty(int x, int y, int width, int height);
+
+	bool Matches(gfx_tilemap_t* tilemap) {
+		return bValid && !memcmp(&Tilemap, tilemap, sizeof(Tilemap)) &&
+			Clip[0] == GFX.Clip_MinX && Clip[1] == GFX.Clip_MinY && Clip[2] == GFX.Clip_MaxX && Clip[3] == GFX.Clip_MaxY &&
+			(GFX.bIndexed || !memcmp(Palette, GFX.Palette, sizeof(Palette)));
+	}
+
+	// visible part of the grid
+	void GetWindow(int baseX, int baseY, int numCols, int numRows, int& x1, int& y1, int& x2, int& y2) {
+		x1 = max(baseX, Clip[0]);
+		y1 = max(baseY, Clip[1]);
+		x2 = min(baseX + numCols * Tilemap.tile_width, Clip[2]);
+		y2 = min(baseY + numRows * Tilemap.tile_height, Clip[3]);
+	}
+
+	bool Scroll(int tileX, int tileY, int baseX, int baseY, int numCols, int numRows, int dx, int dy);
+};
+
+static TilemapCache TileCache;
+
+// cells past the bottom of the map are filled with black
+static gfx_sprite_t* const BlackCell = (gfx_sprite_t*) &TileCache.Tilemap;
+static gfx_sprite_t* const UnknownCell = (gfx_sprite_t*) &TileCache.Palette;
+
+void TilemapCache::MarkDirty(int x, int y, int width, int height) {
+	if (!bValid || width <= 0 || height <= 0)
+		return;
+
+	int x2 = min(x + width, BaseX + NumCols * Tilemap.tile_width);
+	int y2 = min(y + height, BaseY + NumRows * Tilemap.tile_height);
+	x = max(x, BaseX);
+	y = max(y, BaseY);
+	if (x >= x2 || y >= y2)
+		return;
+
+	int col1 = (x - BaseX) / Tilemap.tile_width;
+	int col2 = (x2 - 1 - BaseX) / Tilemap.tile_width;
+	int row1 = (y - BaseY) / Tilemap.tile_height;
+	int row2 = (y2 - 1 - BaseY) / Tilemap.tile_height;
+
+	for (int row = row1; row <= row2; row++) {
+		for (int col = col1; col <= col2; col++) {
+			Drawn[row][col] = UnknownCell;
+		}
+	}
+}
+
+// every primitive reports the rectangle it is about to draw over, which waits for those lines if
+// they are still being sent and marks the tilemap cells under it
+static inline void BeginDraw(int x, int y, int width, int height) {
+	Blit.Fence(y, y + height);
+	TileCache.MarkDirty(x, y, width, height);
+}
+
+// moves the pixels of the last draw by the camera delta and lines the cells up with the new grid,
+// cells that were not fully visible or that scrolled in are left unknown. returns false when
+// nothing on screen can be reused.
+bool TilemapCache::Scroll(int tileX, int tileY, int baseX, int baseY, int numCols, int numRows, int dx, int dy) {
+	int oldX1, oldY1, oldX2, oldY2;
+	int newX1, newY1, newX2, newY2;
+	GetWindow(BaseX, BaseY, NumCols, NumRows, oldX1, oldY1, oldX2, oldY2);
+	GetWindow(baseX, baseY, numCols, numRows, newX1, newY1, newX2, newY2);
+
+	// destination of the pixels still on screen
+	int x1 = max(newX1, oldX1 - dx);
+	int y1 = max(newY1, oldY1 - dy);
+	int x2 = min(newX2, oldX2 - dx);
+	int y2 = min(newY2, oldY2 - dy);
+	if (x1 >= x2 || y1 >= y2)
+		return false;
+
+	Blit.Fence(y1, y2);
+
+	const int pixelBytes = PixelBytes();
+	const int pitch = gfx_lcdWidth * pixelBytes;
+	const int width = (x2 - x1) * pixelBytes;
+	const int offset = dy * pitch + dx * pixelBytes;
+	if (dy > 0) {
+		uint8_t* target = GetTargetBytes(x1, y1);
+		for (int y = y1; y < y2; y++, target += pitch) {
+			memmove(target, target + offset, width);
+		}
+	} else {
+		uint8_t* target = GetTargetBytes(x1, y2 - 1);
+		for (int y = y2 - 1; y >= y1; y--, target -= pitch) {
+			memmove(target, target + offset, width);
+		}
+	}
+
+	// cells are map aligned, so each one either moved whole or is new
+	gfx_sprite_t* old[MaxRows][MaxCols];
+	memcpy(old, Drawn, sizeof(old));
+
+	const int tw = Tilemap.tile_width;
+	const int th = Tilemap.tile_height;
+	for (int row = 0; row < numRows; row++) {
+		int oldRow = row + tileY - TileY;
+		int oldY = BaseY + oldRow * th;
+		bool bRowVisible = oldRow >= 0 && oldRow < NumRows && oldY >= Clip[1] && oldY + th <= Clip[3];
+
+		for (int col = 0; col < numCols; col++) {
+			int oldCol = col + tileX - TileX;
+			int oldX = BaseX + oldCol * tw;
+			if (bRowVisible && oldCol >= 0 && oldCol < NumCols && oldX >= Clip[0] && oldX + tw <= Clip[2]) {
+				Drawn[row][col] = old[oldRow][oldCol];
+			} else {
+				Drawn[row][col] = UnknownCell;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Prizm port: RGB565 copies of the sprites in the registered blocks (the tile and sprite appvars),
+// one color per byte so a sprite's colors sit at the same offset as its indices. A sprite is
+// resolved on its first draw into a fixed arena, sized for a few frames of tiles and sprites since
+// whole appvars don't fit in the calculator heap next to the game. A full arena starts over, and
+// so does a palette change. The 8 bit indices are still used as the transparency mask, since they
+// are the same size a separate mask would be.
+struct SpriteColorCache {
+	static const int MaxBlocks = 4;
+	static const unsigned int ArenaSize = 16 * 1024;	// pixels
+	static const int TableSize = 256;
+
+	struct Block {
+		const uint8_t* Data;
+		unsigned int Size;
+	};
+
+	struct Entry {
+		const uint8_t* Data;
+		uint16_t* Colors;
+	};
+
+	Block Blocks[MaxBlocks];
+	Entry Table[TableSize];
+	int NumEntries = 0;
+	uint16_t* Arena = nullptr;
+	unsigned int ArenaUsed = 0;
+	bool bNoArena = false;
+	bool bStale = true;
+
+	// registering a block again replaces it, the old data may have moved
+	void Register(unsigned int block, const uint8_t* data, unsigned int size) {
+		if (block >= MaxBlocks)
+			return;
+		Blocks[block].Data = data;
+		Blocks[block].Size = size;
+		bStale = true;
+	}
+
+	void Flush() {
+		memset(Table, 0, sizeof(Table));
+		NumEntries = 0;
+		ArenaUsed = 0;
+		bStale = false;
+	}
+
+	bool Contains(const uint8_t* data) {
+		for (int i = 0; i < MaxBlocks; i++) {
+			if (data >= Blocks[i].Data && data < Blocks[i].Data + Blocks[i].Size)
+				return true;
+		}
+		return false;
+	}
+
+	// colors lined up with data, or null if it isn't in a block or there is no room. sizeOf gives
+	// the size of the sprite data, only needed the first time
+	template<typename SizeOf>
+	const uint16_t* Find(const uint8_t* data, SizeOf sizeOf) {
+		if (bStale) {
+			Flush();
+		}
+
+		unsigned int index = (unsigned int)(((uintptr_t) data >> 1) * 2654435761u) % TableSize;
+		for (;;) {
+			Entry& entry = Table[index];
+			if (entry.Data == data)
+				return entry.Colors;
+			if (!entry.Data)
+				break;
+			index = (index + 1) % TableSize;
+		}
+
+		if (bNoArena || !Contains(data))
+			return nullptr;
+		if (!Arena) {
+			Arena = (uint16_t*) malloc(ArenaSize * sizeof(uint16_t));
+			if (!Arena) {
+				bNoArena = true;
+				return nullptr;
+			}
+		}
+
+		unsigned int size = sizeOf();
+		if (size > ArenaSize)
+			return nullptr;
+
+		// leave a quarter of the table free so probes stay short
+		if (ArenaUsed + size > ArenaSize || NumEntries >= TableSize * 3 / 4) {
+			Flush();
+			index = (unsigned int)(((uintptr_t) data >> 1) * 2654435761u) % TableSize;
+		}
+		while (Table[index].Data) {
+			index = (index + 1) % TableSize;
+		}
+
+		uint16_t* colors = Arena + ArenaUsed;
+		for (unsigned int j = 0; j < size; j++) {
+			colors[j] = GFX.ResolvePalette(data[j]);
+		}
+		ArenaUsed += size;
+		Table[index].Data = data;
+		Table[index].Colors = colors;
+		NumEntries++;
+		return colors;
+	}
+};
+
+static SpriteColorCache SpriteColors;
+
+// size of an RLE sprite's data, walking every row
+static unsigned int RLEDataSize(gfx_rletsprite_t* sprite) {
+	const uint8_t* spriteData = sprite->data;
+	for (int y = 0; y < sprite->height; y++) {
+		int curWidth = sprite->width;
+		bool bTransparent = true;
+		while (curWidth > 0) {
+			uint8 curRun = *(spriteData++);
+			if (!bTransparent) {
+				spriteData += curRun;
+			}
+			bTransparent = !bTransparent;
+			curWidth -= curRun;
+		}
+	}
+	return (unsigned int)(spriteData - sprite->data);
+}
+
+static inline const uint16_t* ResolvedColors(gfx_sprite_t* sprite) {
+	return SpriteColors.Find(sprite->data, [sprite]() { return (unsigned int) sprite->width * sprite->height; });
+}
+
+static inline const uint16_t* ResolvedColors(gfx_rletsprite_t* sprite) {
+	return SpriteColors.Find(sprite->data, [sprite]() { return RLEDataSize(sprite); });
+}
+
+// pixels of sprite data in the back buffer format, lined up with the data, or null when each index
+// has to be resolved. indices are drawn as they are
+template<typename Pixel, typename Sprite>
+inline const Pixel* SpritePixels(Sprite* sprite) {
+	if (sizeof(Pixel) == sizeof(uint8_t)) {
+		return (const Pixel*) sprite->data;
+	}
+	return (const Pixel*) ResolvedColors(sprite);
+}
+
+// Prizm port: opaque runs of each transparent sprite drawn from a resolved block, so drawing copies
+// whole runs and clips per run instead of testing every pixel. Built on a sprite's first draw, since
+// the appvar data is fixed once loaded. Sprites outside the blocks, like the oiram buffers the game
+// copies frames into, keep the per pixel path.
+struct SpriteSpanCache {
+	static const int TableSize = 512;
+
+	struct SpanList {
+		uint16_t NumRows;
+		uint16_t* RowStart;		// index of the first run of each row, plus one past the last row
+		uint8_t* Runs;			// x, length pairs
+	};
+
+	struct Entry {
+		gfx_sprite_t* Sprite;
+		SpanList* Spans;
+	};
+
+	Entry Table[TableSize];
+	int NumEntries = 0;
+
+	void Flush() {
+		for (int i = 0; i < TableSize; i++) {
+			free(Table[i].Spans);
+			Table[i].Sprite = nullptr;
+			Table[i].Spans = nullptr;
+		}
+		NumEntries = 0;
+	}
+
+	static SpanList* Build(gfx_sprite_t* sprite) {
+		const int width = sprite->width;
+		const int height = sprite->height;
+
+		// count runs first so everything fits in one allocation
+		int numRuns = 0;
+		const uint8_t* data = sprite->data;
+		for (int y = 0; y < height; y++, data += width) {
+			for (int x = 0; x < width; x++) {
+				if (data[x] != GFX.TransparentIndex && (x == 0 || data[x - 1] == GFX.TransparentIndex)) {
+					numRuns++;
+				}
+			}
+		}
+
+		SpanList* spans = (SpanList*) malloc(sizeof(SpanList) + (height + 1) * sizeof(uint16_t) + numRuns * 2);
+		if (!spans)
+			return nullptr;
+		spans->NumRows = height;
+		spans->RowStart = (uint16_t*)(spans + 1);
+		spans->Runs = (uint8_t*)(spans->RowStart + height + 1);
+
+		int run = 0;
+		data = sprite->data;
+		for (int y = 0; y < height; y++, data += width) {
+			spans->RowStart[y] = run;
+			for (int x = 0; x < width;) {
+				if (data[x] == GFX.TransparentIndex) {
+					x++;
+					continue;
+				}
+				int start = x;
+				while (x < width && data[x] != GFX.TransparentIndex) {
+					x++;
+				}
+				spans->Runs[run * 2] = start;
+				spans->Runs[run * 2 + 1] = x - start;
+				run++;
+			}
+		}
+		spans->RowStart[height] = run;
+
+		return spans;
+	}
+
+	SpanList* Find(gfx_sprite_t* sprite) {
+		unsigned int index = (unsigned int)(((uintptr_t) sprite >> 1) * 2654435761u) % TableSize;
+		for (;;) {
+			Entry& entry = Table[index];
+			if (entry.Sprite == sprite)
+				return entry.Spans;
+			if (!entry.Sprite) {
+				// leave a quarter of the table free so probes stay short
+				if (NumEntries >= TableSize * 3 / 4)
+					return nullptr;
+				entry.Sprite = sprite;
+				entry.Spans = Build(sprite);
+				NumEntries++;
+				return entry.Spans;
+			}
+			index = (index + 1) % TableSize;
+		}
+	}
+};
+
+static SpriteSpanCache SpriteSpans;
+
+// Prizm port: class of each tile in the tileset, so gfx_Tilemap can fill single color tiles
+// instead of copying them. Tiles are drawn opaque, so keyed tiles take the copy path as well.
+enum TileClass {
+	TILE_OPAQUE,
+	TILE_KEYED,
+	TILE_UNIFORM
+};
+
+struct TileClassTable {
+	const uint8_t* First = nullptr;
+	unsigned int Count = 0;
+	unsigned int Stride = 0;
+	uint8_t Class[256];
+	uint8_t Color[256];
+
+	// class of a tile sprite, or TILE_OPAQUE for sprites outside the tileset
+	TileClass Find(gfx_sprite_t* sprite, uint8_t& color) {
+		unsigned int offset = (unsigned int)((const uint8_t*) sprite - First);
+		if (offset >= Count * Stride || offset % Stride)
+			return TILE_OPAQUE;
+		unsigned int index = offset / Stride;
+		color = Color[index];
+		return (TileClass) Class[index];
+	}
+};
+
+static TileClassTable TileClasses;
+
+// Prizm port: byte offset of every row of indexed RLE sprites, so clipped drawing can start at the
+// first visible row instead of decoding the hidden ones
+struct RLERowTable {
+	static const int MaxSprites = 8;
+
+	struct Entry {
+		gfx_rletsprite_t* Sprite;
+		uint16_t* RowOffset;
+	};
+
+	Entry Sprites[MaxSprites];
+	int NextSlot = 0;
+
+	void Add(gfx_rletsprite_t* sprite) {
+		Entry* entry = nullptr;
+		for (int i = 0; i < MaxSprites; i++) {
+			if (Sprites[i].Sprite == sprite || !Sprites[i].Sprite) {
+				entry = &Sprites[i];
+				break;
+			}
+		}
+		if (!entry) {
+			entry = &Sprites[NextSlot];
+			NextSlot = (NextSlot + 1) % MaxSprites;
+		}
+
+		free(entry->RowOffset);
+		entry->Sprite = sprite;
+		entry->RowOffset = (uint16_t*) malloc(sprite->height * sizeof(uint16_t));
+		if (!entry->RowOffset) {
+			entry->Sprite = nullptr;
+			return;
+		}
+
+		const uint8_t* spriteData = sprite->data;
+		for (int y = 0; y < sprite->height; y++) {
+			entry->RowOffset[y] = (uint16_t)(spriteData - sprite->data);
+			int curWidth = sprite->width;
+			bool bTransparent = true;
+			while (curWidth > 0) {
+				uint8 curRun = *(spriteData++);
+				if (!bTransparent) {
+					spriteData += curRun;
+				}
+				bTransparent = !bTransparent;
+				curWidth -= curRun;
+			}
+		}
+	}
+
+	const uint16_t* Find(gfx_rletsprite_t* sprite) {
+		for (int i = 0; i < MaxSprites; i++) {
+			if (Sprites[i].Sprite == sprite)
+				return Sprites[i].RowOffset;
+		}
+		return nullptr;
+	}
+};
+
+static RLERowTable RLERows;
+
+template<bool bClip, bool bTransparent, typename Pixel>
 void RenderSprite(gfx_sprite_t *sprite, int x, int y) {
 	CheckClip();
 
@@ -185,17 +912,60 @@ void RenderSprite(gfx_sprite_t *sprite, int x, int y) {
 	}
 
 	uint8_t* spriteData = sprite->data;
-	uint16_t* targetLine = GetTargetAddr(x, y);
+	Pixel* targetLine = GetTarget<Pixel>(x, y);
 
 	if (y0) {
 		spriteData += y0 * sprite->width;
 		targetLine += y0 * gfx_lcdWidth;
 	}
 
+	const Pixel* spriteColors = SpritePixels<Pixel>(sprite);
+	SpriteSpanCache::SpanList* spans = (bTransparent && spriteColors && SpriteColors.Contains(sprite->data)) ? SpriteSpans.Find(sprite) : nullptr;
+	if (spans) {
+		spriteColors += spriteData - sprite->data;
+		for (; y0 < h; y0++) {
+			const uint8_t* run = &spans->Runs[spans->RowStart[y0] * 2];
+			const uint8_t* runEnd = &spans->Runs[spans->RowStart[y0 + 1] * 2];
+			for (; run < runEnd; run += 2) {
+				int start = run[0];
+				int end = start + run[1];
+				if (bClip) {
+					start = max(start, x0);
+					end = min(end, w);
+				}
+				for (int xPix = start; xPix < end; xPix++) {
+					targetLine[xPix] = spriteColors[xPix];
+				}
+			}
+			spriteColors += sprite->width;
+			targetLine += gfx_lcdWidth;
+		}
+		return;
+	}
+
+	if (spriteColors) {
+		spriteColors += spriteData - sprite->data;
+		for (; y0 < h; y0++) {
+			if (bTransparent) {
+				for (int xPix = x0; xPix < w; xPix++) {
+					if (spriteData[xPix] != GFX.TransparentIndex) {
+						targetLine[xPix] = spriteColors[xPix];
+					}
+				}
+			} else if (x0 < w) {
+				memcpy(&targetLine[x0], &spriteColors[x0], (w - x0) * sizeof(Pixel));
+			}
+			spriteData += sprite->width;
+			spriteColors += sprite->width;
+			targetLine += gfx_lcdWidth;
+		}
+		return;
+	}
+
 	for (; y0 < h; y0++) {
 		for (int xPix = x0; xPix < w; xPix++) {
 			if (!bTransparent || spriteData[xPix] != GFX.TransparentIndex) {
-				targetLine[xPix] = GFX.ResolvePalette(spriteData[xPix]);
+				targetLine[xPix] = IndexColor<Pixel>(spriteData[xPix]);
 			}
 		}
 		spriteData += sprite->width;
@@ -203,7 +973,7 @@ void RenderSprite(gfx_sprite_t *sprite, int x, int y) {
 	}
 }
 
-template<bool bClip>
+template<bool bClip, typename Pixel>
 void RenderRLESprite(gfx_rletsprite_t *sprite, int x, int y) {
 	CheckClip();
 
@@ -218,9 +988,12 @@ void RenderRLESprite(gfx_rletsprite_t *sprite, int x, int y) {
 	}
 
 	uint8_t* spriteData = sprite->data;
-	uint16_t* targetLine = GetTargetAddr(x, y+y0);
+	Pixel* targetLine = GetTarget<Pixel>(x, y+y0);
 
-	if (y0) {
+	const uint16_t* rowOffset = bClip ? RLERows.Find(sprite) : nullptr;
+	if (rowOffset) {
+		spriteData += rowOffset[y0];
+	} else if (y0) {
 		for (int lines = 0; lines < y0; lines++) {
 			int curWidth = sprite->width;
 			bool bTransparent = true;
@@ -235,65 +1008,110 @@ void RenderRLESprite(gfx_rletsprite_t *sprite, int x, int y) {
 		}
 	}
 
+	// colors are looked up at the same offset as the run data
+	const Pixel* spriteColors = SpritePixels<Pixel>(sprite);
+
 	for (; y0 < h; y0++) {
+		if (rowOffset) {
+			spriteData = sprite->data + rowOffset[y0];
+		}
+
 		int curWidth = sprite->width;
 		int xPix = 0;
 		bool bTransparent = true;
 		while (curWidth > 0) {
 			uint8 curRun = *(spriteData++);
 			if (!bTransparent) {
-				for (uint8 pix = 0; pix < curRun; pix++, xPix++) {
-					if (!bClip || (xPix >= x0 && xPix < w)) {
-						targetLine[xPix] = GFX.ResolvePalette(*spriteData);
+				// trim the run to the clip window
+				int start = xPix;
+				int end = xPix + curRun;
+				if (bClip) {
+					start = max(start, x0);
+					end = min(end, w);
+				}
+				const uint8_t* runData = spriteData + (start - xPix);
+				if (spriteColors) {
+					const Pixel* runColors = spriteColors + (runData - sprite->data);
+					for (int pix = start; pix < end; pix++) {
+						targetLine[pix] = *(runColors++);
+					}
+				} else {
+					for (int pix = start; pix < end; pix++) {
+						targetLine[pix] = IndexColor<Pixel>(*(runData++));
 					}
-					spriteData++;
 				}
-			} else {
-				xPix += curRun;
+				spriteData += curRun;
 			}
+			xPix += curRun;
 			bTransparent = !bTransparent;
 			curWidth -= curRun;
+
+			// the rest of the row is clipped, the next row starts at its offset
+			if (bClip && rowOffset && xPix >= w)
+				break;
 		}
 		targetLine += gfx_lcdWidth;
 	}
 }
 
+static inline void MarkSprite(gfx_sprite_t *sprite, int x, int y) {
+	if (sprite) {
+		BeginDraw(x, y, sprite->width, sprite->height);
+	}
+}
+
+template<bool bClip, bool bTransparent>
+static inline void DrawSprite(gfx_sprite_t *sprite, int x, int y) {
+	if (GFX.bIndexed) {
+		RenderSprite<bClip, bTransparent, uint8_t>(sprite, x, y);
+	} else {
+		RenderSprite<bClip, bTransparent, uint16_t>(sprite, x, y);
+	}
+}
+
+template<bool bClip>
+static inline void DrawRLESprite(gfx_rletsprite_t *sprite, int x, int y) {
+	if (GFX.bIndexed) {
+		RenderRLESprite<bClip, uint8_t>(sprite, x, y);
+	} else {
+		RenderRLESprite<bClip, uint16_t>(sprite, x, y);
+	}
+}
+
 void gfx_Sprite(gfx_sprite_t *sprite, int x, int y) {
-	RenderSprite<true, false>(sprite, x, y);
+	MarkSprite(sprite, x, y);
+	DrawSprite<true, false>(sprite, x, y);
 }
 
 void gfx_Sprite_NoClip(gfx_sprite_t *sprite, uint24_t x, uint8_t y) {
-	RenderSprite<false, false>(sprite, x, y);
+	MarkSprite(sprite, x, y);
+	DrawSprite<false, false>(sprite, x, y);
 }
 
 void gfx_TransparentSprite(gfx_sprite_t *sprite, int x, int y) {
-	RenderSprite<true, true>(sprite, x, y);
+	MarkSprite(sprite, x, y);
+	DrawSprite<true, true>(sprite, x, y);
 }
 
 void gfx_TransparentSprite_NoClip(gfx_sprite_t *sprite, uint24_t x, uint8_t y) {
-	RenderSprite<false, true>(sprite, x, y);
+	MarkSprite(sprite, x, y);
+	DrawSprite<false, true>(sprite, x, y);
 }
 
-void gfx_ScaledTransparentSprite_NoClip(gfx_sprite_t *sprite,
-	uint24_t x,
-	uint8_t y,
-	uint8_t width_scale,
-	uint8_t height_scale) {
-
-	CheckClip();
-
+template<typename Pixel>
+static void RenderScaledSprite(gfx_sprite_t *sprite, int x, int y, uint8_t width_scale, uint8_t height_scale) {
 	uint8_t* spriteData = sprite->data;
-	uint16_t* targetLine = GetTargetAddr(x, y);
+	Pixel* targetLine = GetTarget<Pixel>(x, y);
 	const unsigned int pitch = gfx_lcdWidth * height_scale;
 
 	for (int y0 = 0; y0 < sprite->height; y0++) {
-		uint16_t* bufferTarget = targetLine;
+		Pixel* bufferTarget = targetLine;
 		for (int x0 = 0; x0 < sprite->width; x0++, spriteData++) {
 			if (*spriteData != GFX.TransparentIndex) {
 				int yOffset = 0;
 				for (int yScale = 0; yScale < height_scale; yScale++) {
 					for (int xScale = 0; xScale < width_scale; xScale++) {
-						bufferTarget[xScale + yOffset] = GFX.ResolvePalette(*(spriteData));
+						bufferTarget[xScale + yOffset] = IndexColor<Pixel>(*(spriteData));
 					}
 					yOffset += gfx_lcdWidth;
 				}
@@ -305,6 +1123,23 @@ void gfx_ScaledTransparentSprite_NoClip(gfx_sprite_t *sprite,
 	}
 }
 
+void gfx_ScaledTransparentSprite_NoClip(gfx_sprite_t *sprite,
+	uint24_t x,
+	uint8_t y,
+	uint8_t width_scale,
+	uint8_t height_scale) {
+
+	CheckClip();
+
+	BeginDraw(x, y, sprite->width * width_scale, sprite->height * height_scale);
+
+	if (GFX.bIndexed) {
+		RenderScaledSprite<uint8_t>(sprite, x, y, width_scale, height_scale);
+	} else {
+		RenderScaledSprite<uint16_t>(sprite, x, y, width_scale, height_scale);
+	}
+}
+
 gfx_sprite_t *gfx_FlipSpriteY(gfx_sprite_t *sprite_in,
 	gfx_sprite_t *sprite_out) {
 
@@ -330,7 +1165,10 @@ void gfx_RLETSprite(gfx_rletsprite_t *sprite,
 
 	CheckClip();
 
-	RenderRLESprite<true>(sprite, x, y);
+	if (sprite) {
+		BeginDraw(x, y, sprite->width, sprite->height);
+	}
+	DrawRLESprite<true>(sprite, x, y);
 }
 
 void gfx_RLETSprite_NoClip(gfx_rletsprite_t *sprite,
@@ -339,7 +1177,10 @@ void gfx_RLETSprite_NoClip(gfx_rletsprite_t *sprite,
 
 	CheckClip();
 
-	RenderRLESprite<false>(sprite, x, y);
+	if (sprite) {
+		BeginDraw(x, y, sprite->width, sprite->height);
+	}
+	DrawRLESprite<false>(sprite, x, y);
 }
 
 void gfx_SetPalette(void *palette,
@@ -356,15 +1197,53 @@ void gfx_SetPalette(void *palette,
 			((srcColor[0] & 0b0000001111100000) << 1) |
 		     (srcColor[0] & 0b0000000000011111);
 	}
+
+	SpriteColors.bStale = true;
+}
+
+void gfx_ResolveSprites(unsigned int block, void *data, unsigned int size) {
+	SpriteColors.Register(block, (const uint8_t*) data, size);
+	SpriteSpans.Flush();
+}
+
+void gfx_IndexRLETSprite(gfx_rletsprite_t *sprite) {
+	RLERows.Add(sprite);
+}
+
+void gfx_ClassifyTiles(void *tiles, unsigned int count, unsigned int stride) {
+	count = min(count, 256u);
+	TileClasses.First = (const uint8_t*) tiles;
+	TileClasses.Count = count;
+	TileClasses.Stride = stride;
+
+	for (unsigned int i = 0; i < count; i++) {
+		gfx_sprite_t* tile = (gfx_sprite_t*)(TileClasses.First + i * stride);
+		const unsigned int size = tile->width * tile->height;
+
+		bool bUniform = true;
+		bool bKeyed = false;
+		for (unsigned int j = 0; j < size; j++) {
+			bUniform = bUniform && tile->data[j] == tile->data[0];
+			bKeyed = bKeyed || tile->data[j] == GFX.TransparentIndex;
+		}
+
+		TileClasses.Class[i] = bUniform ? TILE_UNIFORM : (bKeyed ? TILE_KEYED : TILE_OPAQUE);
+		TileClasses.Color[i] = tile->data[0];
+	}
 }
 
 uint8_t gfx_SetTransparentColor(uint8_t index) {
 	uint8_t PrevIndex = GFX.TransparentIndex;
+	if (index != PrevIndex) {
+		SpriteSpans.Flush();
+	}
 	GFX.TransparentIndex = index;
 	return PrevIndex;
 }
 
 uint16_t* GetGFXPalette() {
+	// the caller may write to it
+	SpriteColors.bStale = true;
 	return GFX.Palette;
 }
 
@@ -396,19 +1275,47 @@ void gfx_Begin() {
 }
 
 void gfx_End() {
+	Blit.Wait();
 #if TARGET_PRIZM
-	DmaWaitNext();
 	*((volatile unsigned*)MSTPCR0) &= ~(1 << 21);//Clear bit 21
 #endif
 }
 
 void gfx_FillScreen(uint8_t index) {
-	uint16_t Color = GFX.ResolvePalette(index);
-	uint16_t* DestColor = BackBuffer();
-	for (int y = 0; y < gfx_lcdHeight; y++) {
-		for (int x = 0; x < gfx_lcdWidth; x++) {
-			*(DestColor++) = Color;
-		}
+	Blit.Fence(0, gfx_lcdHeight);
+	TileCache.Invalidate();
+
+	// the buffer is contiguous
+	if (GFX.bIndexed) {
+		FillPixels(IndexBuffer(), gfx_lcdWidth * gfx_lcdHeight, index);
+	} else {
+		FillPixels(BackBuffer(), gfx_lcdWidth * gfx_lcdHeight, GFX.ResolvePalette(index));
+	}
+}
+
+template<typename Pixel>
+static void RenderRectangle(int x, int y, int width, int height) {
+	const Pixel color = DrawColor<Pixel>();
+	Pixel* targetLine = GetTarget<Pixel>(x, y);
+
+	FillPixels(targetLine, width, color);
+	targetLine += gfx_lcdWidth;
+
+	for (int y0 = 1; y0 + 1 < height; y0++) {
+		targetLine[0] = color;
+		targetLine[width - 1] = color;
+		targetLine += gfx_lcdWidth;
+	}
+
+	FillPixels(targetLine, width, color);
+}
+
+template<typename Pixel>
+static void RenderFillRectangle(int x, int y, int width, int height, Pixel color) {
+	Pixel* targetLine = GetTarget<Pixel>(x, y);
+	for (int y0 = 0; y0 < height; y0++) {
+		FillPixels(targetLine, width, color);
+		targetLine += gfx_lcdWidth;
 	}
 }
 
@@ -432,23 +1339,12 @@ void gfx_Rectangle_NoClip(uint24_t x,
 
 	CheckClip();
 
-	uint16_t* targetLine = GetTargetAddr(x, y);
+	BeginDraw(x, y, width, height);
 
-	uint16_t* bufferLine = targetLine;
-	for (uint32 x0 = 0; x0 < width; x0++) {
-		*(bufferLine++) = GFX.CurColor;
-	}
-	targetLine += gfx_lcdWidth;
-
-	for (uint32 y0 = 1; y0 + 1 < height; y0++) {
-		targetLine[0] = GFX.CurColor;
-		targetLine[width - 1] = GFX.CurColor;
-		targetLine += gfx_lcdWidth;
-	}
-
-	bufferLine = targetLine;
-	for (uint32 x0 = 0; x0 < width; x0++) {
-		*(bufferLine++) = GFX.CurColor;
+	if (GFX.bIndexed) {
+		RenderRectangle<uint8_t>(x, y, width, height);
+	} else {
+		RenderRectangle<uint16_t>(x, y, width, height);
 	}
 }
 
@@ -472,59 +1368,148 @@ void gfx_FillRectangle_NoClip(uint24_t x,
 
 	CheckClip();
 
-	uint16_t* targetLine = GetTargetAddr(x, y);
-	for (uint32 y0 = 0; y0 < height; y0++) {
-		for (uint32 x0 = 0; x0 < width; x0++) {
-			targetLine[x0] = GFX.CurColor;
-		}
-		targetLine += gfx_lcdWidth;
+	BeginDraw(x, y, width, height);
+
+	if (GFX.bIndexed) {
+		RenderFillRectangle<uint8_t>(x, y, width, height, DrawColor<uint8_t>());
+	} else {
+		RenderFillRectangle<uint16_t>(x, y, width, height, DrawColor<uint16_t>());
 	}
 }
 
 void gfx_SetPixel(uint24_t x, uint8_t y) {
 	CheckClip();
 
-	uint16_t* targetLine = GetTargetAddr(x, y);
-	targetLine[0] = GFX.CurColor;
+	BeginDraw(x, y, 1, 1);
+
+	if (GFX.bIndexed) {
+		*GetTarget<uint8_t>(x, y) = DrawColor<uint8_t>();
+	} else {
+		*GetTarget<uint16_t>(x, y) = DrawColor<uint16_t>();
+	}
+}
+
+// Prizm port: the indexed buffer is resolved a strip at a time. There are two strips, so one is
+// resolved while the other is being sent. On the calculator they sit in VRAM after the indexed buffer
+static uint16_t* StripBuffer(int index) {
+#if TARGET_PRIZM
+	uint16_t* strips = (uint16_t*)(IndexBuffer() + gfx_lcdWidth * gfx_lcdHeight);
+#else
+	static uint16_t strips[2 * StripLines * gfx_lcdWidth];
+#endif
+	return strips + index * StripLines * gfx_lcdWidth;
+}
+
+static inline void ResolveLine(uint16_t* target, const uint8_t* source, int count) {
+	const uint16_t* palette = GFX.Palette;
+	for (; count >= 4; count -= 4, target += 4, source += 4) {
+		target[0] = palette[source[0]];
+		target[1] = palette[source[1]];
+		target[2] = palette[source[2]];
+		target[3] = palette[source[3]];
+	}
+	for (; count > 0; count--) {
+		*target++ = palette[*source++];
+	}
+}
+
+// the indexed buffer goes through the palette on its way to the display
+static void BlitIndexedSection(int y1, int h) {
+	const uint8_t* SourceAddr = IndexBuffer() + (gfx_lcdWidth * y1);
+
+	// the last strip of the previous blit may still be in flight, so this carries on with the other
+	static int strip = 0;
+
+	for (int y = y1; y < y1 + h; y += StripLines, strip ^= 1) {
+		int lines = min(StripLines, y1 + h - y);
+
+		// the strip sent before the previous one is done, Send waited for it
+		uint16_t* target = StripBuffer(strip);
+		ResolveLine(target, SourceAddr, lines * gfx_lcdWidth);
+		SourceAddr += lines * gfx_lcdWidth;
+
+		Blit.Send(target, y, lines, false);
+	}
 }
 
 static void BlitScreenSection(int y1, int h) {
-	uint16_t* SourceAddr = BackBuffer() + (gfx_lcdWidth * y1);
+	if (GFX.bIndexed) {
+		BlitIndexedSection(y1, h);
+		return;
+	}
 
-#if TARGET_PRIZM
-	const int ScreenOffset = (396 - gfx_lcdWidth) / 2;
-	DmaWaitNext();
+	// queued a strip at a time, drawing over these lines waits until they are sent
+	Blit.Send(BackBuffer() + (gfx_lcdWidth * y1), y1, h, true);
+}
 
-	Bdisp_WriteDDRegister3_bit7(1);
-	Bdisp_DefineDMARange(ScreenOffset, ScreenOffset + gfx_lcdWidth - 1, y1, y1+h);
-	Bdisp_DDRegisterSelect(LCD_GRAM);
+// Prizm port: lines queued with gfx_QueueLines over a frame, sent together by gfx_FlushLines
+struct LineQueue {
+	bool bAny = false;
+	uint8_t Dirty[gfx_lcdHeight];
+
+	void Add(int y, int lines) {
+		y = max(y, 0);
+		lines = min(y + lines, gfx_lcdHeight) - y;
+		if (lines > 0) {
+			memset(&Dirty[y], 1, lines);
+			bAny = true;
+		}
+	}
 
-	DmaDrawStrip(SourceAddr, h * gfx_lcdWidth * 2);
-	DmaWaitNext();
-#endif
+	void Clear() {
+		if (bAny) {
+			memset(Dirty, 0, sizeof(Dirty));
+			bAny = false;
+		}
+	}
 
-#if TARGET_WINSIM
-	const int ScreenOffset = (LCD_WIDTH_PX - gfx_lcdWidth) / 2;
-	h = min(LCD_HEIGHT_PX, y1 + h) - y1;
-	if (h > 0) {
-		uint16_t* TargetAddr = ((uint16_t*)GetVRAMAddress()) + ScreenOffset + LCD_WIDTH_PX * y1;
-		for (int32 i = 0; i < h; i++, TargetAddr += LCD_WIDTH_PX, SourceAddr += gfx_lcdWidth) {
-			memcpy(TargetAddr, SourceAddr, gfx_lcdWidth * 2);
+	void Flush() {
+		if (!bAny)
+			return;
+
+		for (int y = 0; y < gfx_lcdHeight; y++) {
+			if (!Dirty[y])
+				continue;
+
+			// ranges that touch or overlap are sent as one, lines that were not queued are not sent
+			int end = y + 1;
+			while (end < gfx_lcdHeight && Dirty[end]) {
+				end++;
+			}
+
+			BlitScreenSection(y, end - y);
+			y = end;
 		}
-		Bdisp_PutDisp_DD();
+
+		Clear();
 	}
-#endif
-}
+};
+
+static LineQueue QueuedLines;
 
 void gfx_Blit(gfx_location_t src) {
 	// only one way supported
 	DebugAssert(src == gfx_buffer);
 
 	if (src == gfx_buffer) {
+		// anything queued goes with it
+		QueuedLines.Clear();
 		BlitScreenSection(0, 224);
 	}
 }
 
+void gfx_QueueLines(uint8_t y_loc, uint8_t num_lines) {
+	QueuedLines.Add(y_loc, num_lines);
+}
+
+void gfx_FlushLines(void) {
+	QueuedLines.Flush();
+}
+
+void gfx_Wait(void) {
+	Blit.Wait();
+}
+
 void gfx_SetDraw(uint8_t location) {
 	DebugAssert(location == gfx_buffer);
 }
@@ -541,37 +1526,48 @@ void gfx_BlitLines(gfx_location_t src,
 	}
 }
 
-void gfx_FillCircle(int x,
-	int y,
-	uint24_t radius) {
-
-	CheckClip();
-
-	int width = radius * 2;
-	int height = radius * 2;
-	int x1 = x - radius;
-	int y1 = y - radius;
-	GFX.ClipRect(x1, y1, width, height);
-
+template<typename Pixel>
+static void RenderCircle(int x, int y, int radius, int x1, int y1, int width, int height) {
 	int x2 = x1 + width;
 	int y2 = y1 + height;
 
 	int rSq = radius * radius;
 
-	uint16_t* targetLine = GetTargetAddr(0, y1);
+	const Pixel color = DrawColor<Pixel>();
+	Pixel* targetLine = GetTarget<Pixel>(0, y1);
 
 	for (int curY = y1; curY < y2; curY++) {
 		int distSqBase = (y - curY) * (y - curY);
 		for (int curX = x1; curX < x2; curX++) {
 			int distSQ = (x - curX) * (x - curX) + distSqBase;
 			if (distSQ <= rSq) {
-				targetLine[curX] = GFX.CurColor;
+				targetLine[curX] = color;
 			}
 		}
 		targetLine += gfx_lcdWidth;
 	}
 }
 
+void gfx_FillCircle(int x,
+	int y,
+	uint24_t radius) {
+
+	CheckClip();
+
+	int width = radius * 2;
+	int height = radius * 2;
+	int x1 = x - radius;
+	int y1 = y - radius;
+	GFX.ClipRect(x1, y1, width, height);
+	BeginDraw(x1, y1, width, height);
+
+	if (GFX.bIndexed) {
+		RenderCircle<uint8_t>(x, y, radius, x1, y1, width, height);
+	} else {
+		RenderCircle<uint16_t>(x, y, radius, x1, y1, width, height);
+	}
+}
+
 uint8_t gfx_SetTextFGColor(uint8_t color) {
 	uint8_t ret = GFX.LastTextColorIndex;
 	GFX.CurTextColor = GFX.ResolvePalette(color);
@@ -597,7 +1593,160 @@ void gfx_SetMonospaceFont(uint8_t spacing) {
 	// todo
 }
 
+// Prizm port: the printable characters rasterized once through CalcType and kept as runs of set
+// pixels per row, so text is drawn straight into the back buffer in any color and its width is a
+// table lookup. Only used when the font draws solid pixels and its widths add up per character,
+// text goes through CalcType otherwise.
+struct GlyphAtlas {
+	static const int FirstChar = 32;
+	static const int NumChars = 95;
+	static const int MaxWidth = 64;
+	static const int MaxHeight = 32;
+
+	enum AtlasState {
+		ATLAS_UNBUILT,
+		ATLAS_READY,
+		ATLAS_UNUSABLE
+	};
+
+	AtlasState State = ATLAS_UNBUILT;
+	int Height = 0;
+	uint8_t Width[NumChars];
+	uint16_t* RowStart = nullptr;	// first run of each glyph row, NumChars * Height + 1 entries
+	uint8_t* Runs = nullptr;		// x, length pairs
+
+	// renders a glyph into the scratch buffer, returns false if it isn't drawn with solid pixels
+	bool Rasterize(int glyph, uint16_t* scratch) {
+		char string[2] = { (char)(FirstChar + glyph), 0 };
+		memset(scratch, 0, MaxWidth * MaxHeight * sizeof(uint16_t));
+		CalcType_Draw(&arial_small, string, 0, 0, 0xFFFF, (uint8*) scratch, MaxWidth);
+		for (int i = 0; i < MaxWidth * MaxHeight; i++) {
+			if (scratch[i] && scratch[i] != 0xFFFF)
+				return false;
+		}
+		return true;
+	}
+
+	// runs of a glyph's rows, counted only when runs is null
+	int ScanRuns(const uint16_t* scratch, int glyph, uint8_t* runs, int run) {
+		for (int y = 0; y < Height; y++, scratch += MaxWidth) {
+			if (runs) {
+				RowStart[glyph * Height + y] = run;
+			}
+			for (int x = 0; x < MaxWidth;) {
+				if (!scratch[x]) {
+					x++;
+					continue;
+				}
+				int start = x;
+				while (x < MaxWidth && scratch[x]) {
+					x++;
+				}
+				if (runs) {
+					runs[run * 2] = start;
+					runs[run * 2 + 1] = x - start;
+				}
+				run++;
+			}
+		}
+		return run;
+	}
+
+	void Build() {
+		State = ATLAS_UNUSABLE;
+		Height = arial_small.height;
+		if (Height <= 0 || Height > MaxHeight)
+			return;
+
+		// widths have to add up for per character lookups to match CalcType_Width
+		char all[NumChars + 1];
+		unsigned int total = 0;
+		for (int i = 0; i < NumChars; i++) {
+			char string[2] = { (char)(FirstChar + i), 0 };
+			int width = CalcType_Width(&arial_small, string);
+			if (width < 0 || width > MaxWidth)
+				return;
+			Width[i] = width;
+			total += width;
+			all[i] = string[0];
+		}
+		all[NumChars] = 0;
+		if (total != (unsigned int) CalcType_Width(&arial_small, all))
+			return;
+
+		static uint16_t scratch[MaxWidth * MaxHeight];
+		int numRuns = 0;
+		for (int i = 0; i < NumChars; i++) {
+			if (!Rasterize(i, scratch))
+				return;
+			numRuns = ScanRuns(scratch, i, nullptr, numRuns);
+		}
+
+		RowStart = (uint16_t*) malloc((NumChars * Height + 1) * sizeof(uint16_t) + numRuns * 2);
+		if (!RowStart)
+			return;
+		Runs = (uint8_t*)(RowStart + NumChars * Height + 1);
+
+		int run = 0;
+		for (int i = 0; i < NumChars; i++) {
+			Rasterize(i, scratch);
+			run = ScanRuns(scratch, i, Runs, run);
+		}
+		RowStart[NumChars * Height] = run;
+
+		State = ATLAS_READY;
+	}
+
+	// true if every character of the string is in the atlas
+	bool Covers(const char* string) {
+		if (State == ATLAS_UNBUILT) {
+			Build();
+		}
+		if (State != ATLAS_READY)
+			return false;
+		for (; *string; string++) {
+			if ((uint8_t) *string < FirstChar || (uint8_t) *string >= FirstChar + NumChars)
+				return false;
+		}
+		return true;
+	}
+
+	int GetWidth(const char* string) {
+		int width = 0;
+		for (; *string; string++) {
+			width += Width[(uint8_t) *string - FirstChar];
+		}
+		return width;
+	}
+
+	template<typename Pixel>
+	void Draw(const char* string, int x, int y, Pixel color) {
+		const int height = min(Height, gfx_lcdHeight - y);
+		for (; *string; string++) {
+			const int glyph = (uint8_t) *string - FirstChar;
+			Pixel* targetLine = GetTarget<Pixel>(0, y);
+			for (int y0 = 0; y0 < height; y0++, targetLine += gfx_lcdWidth) {
+				const uint8_t* run = &Runs[RowStart[glyph * Height + y0] * 2];
+				const uint8_t* runEnd = &Runs[RowStart[glyph * Height + y0 + 1] * 2];
+				for (; run < runEnd; run += 2) {
+					int start = max(x + run[0], 0);
+					int end = min(x + run[0] + run[1], gfx_lcdWidth);
+					for (int xPix = start; xPix < end; xPix++) {
+						targetLine[xPix] = color;
+					}
+				}
+			}
+			x += Width[glyph];
+		}
+	}
+};
+
+static GlyphAtlas Glyphs;
+
 unsigned int gfx_GetStringWidth(const char *string) {
+	if (Glyphs.Covers(string)) {
+		return Glyphs.GetWidth(string);
+	}
 	return CalcType_Width(&arial_small, string);
 }
 
@@ -606,24 +1755,64 @@ void gfx_SetTextXY(int x, int y) {
 	GFX.TextY = y;
 }
 
+// CalcType only draws RGB565, so indexed text is drawn into a scratch strip first and the pixels it
+// set are written as the text color index
+static void RenderIndexedText(const char *string, int x, int y, int width) {
+	static const int MaxTextHeight = 32;
+	static uint16_t Scratch[gfx_lcdWidth * MaxTextHeight];
+
+	const int height = min((int) arial_small.height, min(MaxTextHeight, gfx_lcdHeight - y));
+	width = min(width, gfx_lcdWidth - x);
+	if (x < 0 || y < 0 || width <= 0 || height <= 0)
+		return;
+
+	memset(Scratch, 0, sizeof(Scratch));
+	CalcType_Draw(&arial_small, string, 0, 0, 0xFFFF, (uint8*)Scratch, gfx_lcdWidth);
+
+	const uint8_t color = GFX.LastTextColorIndex;
+	const uint16_t* scratchLine = Scratch;
+	uint8_t* targetLine = GetTarget<uint8_t>(x, y);
+	for (int y0 = 0; y0 < height; y0++, scratchLine += gfx_lcdWidth, targetLine += gfx_lcdWidth) {
+		for (int x0 = 0; x0 < width; x0++) {
+			if (scratchLine[x0]) {
+				targetLine[x0] = color;
+			}
+		}
+	}
+}
+
 void gfx_PrintStringXY(const char *string, int x, int y) {
 	if (y + arial_small.height >= gfx_lcdHeight)
 		return;
 
 	// render background behind text if BG color is not clear color
-	int32 width = CalcType_Width(&arial_small, string);
+	const bool bAtlas = y >= 0 && Glyphs.Covers(string);
+	int32 width = bAtlas ? Glyphs.GetWidth(string) : CalcType_Width(&arial_small, string);
 
 	{
 		CheckClip();
 
+		BeginDraw(x, y, width, arial_small.height);
+
 		if (GFX.CurTextBGColor != GFX.CurTextClearColor) {
 			uint16_t oldColor = GFX.CurColor;
+			uint8_t oldColorIndex = GFX.LastColorIndex;
 			GFX.CurColor = GFX.CurTextBGColor;
+			GFX.LastColorIndex = GFX.LastTextBGColorIndex;
 			gfx_FillRectangle_NoClip(x, y, width, arial_small.height - 1);
 			GFX.CurColor = oldColor;
+			GFX.LastColorIndex = oldColorIndex;
 		}
 
-		CalcType_Draw(&arial_small, string, x, y, GFX.CurTextColor, (uint8*)BackBuffer(), 320);
+		if (bAtlas && GFX.bIndexed) {
+			Glyphs.Draw<uint8_t>(string, x, y, GFX.LastTextColorIndex);
+		} else if (bAtlas) {
+			Glyphs.Draw<uint16_t>(string, x, y, GFX.CurTextColor);
+		} else if (GFX.bIndexed) {
+			RenderIndexedText(string, x, y, width);
+		} else {
+			CalcType_Draw(&arial_small, string, x, y, GFX.CurTextColor, (uint8*)BackBuffer(), 320);
+		}
 	}
 
 	GFX.TextX = x + width;
@@ -631,26 +1820,105 @@ void gfx_PrintStringXY(const char *string, int x, int y) {
 }
 
 void gfx_PrintUInt(unsigned int n, uint8_t length) {
+	// digits are written from the end, then padded with zeros up to length
 	char buffer[32];
-	sprintf(buffer, "%d", n);
-	int curLength = strlen(buffer);
-
-	char paddedBuffer[32] = { 0 };
-	int i = 0;
-	while (curLength < length) {
-		paddedBuffer[i++] = '0';
-		curLength++;
+	char* digits = &buffer[sizeof(buffer) - 1];
+	*digits = 0;
+	do {
+		*--digits = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	while (&buffer[sizeof(buffer) - 1] - digits < length && digits > buffer) {
+		*--digits = '0';
 	}
-	strcpy(&paddedBuffer[i], buffer);
-	gfx_PrintStringXY(paddedBuffer, GFX.TextX, GFX.TextY);
+	gfx_PrintStringXY(digits, GFX.TextX, GFX.TextY);
 }
 
 void gfx_ShiftDown(uint8_t pixels) {
 	CheckClip();
 
-	int32 shiftAmt = pixels * gfx_lcdWidth;
-	uint16_t* VRAM = BackBuffer();
-	memmove(VRAM + shiftAmt, VRAM, (gfx_lcdWidth * gfx_lcdHeight * 2) - shiftAmt * 2);
+	Blit.Fence(0, gfx_lcdHeight);
+	TileCache.Invalidate();
+
+	const int pixelBytes = PixelBytes();
+	int32 shiftAmt = pixels * gfx_lcdWidth * pixelBytes;
+	uint8_t* buffer = GetTargetBytes(0, 0);
+	memmove(buffer + shiftAmt, buffer, (gfx_lcdWidth * gfx_lcdHeight * pixelBytes) - shiftAmt);
+}
+
+// fills a clipped rectangle of tiles
+template<typename Pixel>
+static void FillTile(int x, int y, int width, int height, Pixel color) {
+	GFX.ClipRect(x, y, width, height);
+	if (width <= 0 || height <= 0)
+		return;
+
+	Pixel* targetLine = GetTarget<Pixel>(x, y);
+	for (int y0 = 0; y0 < height; y0++, targetLine += gfx_lcdWidth) {
+		FillPixels(targetLine, width, color);
+	}
+}
+
+// draws the cells of gfx_Tilemap that are not already on screen
+template<typename Pixel>
+static void RenderTiles(gfx_tilemap_t *tilemap, int baseX, int baseY, int baseTileX, int baseTileY,
+	unsigned int numCols, unsigned int numRows, unsigned int mapRows, bool bFull) {
+
+	const int tileWidth = tilemap->tile_width;
+	const int tileHeight = tilemap->tile_height;
+	const Pixel blackColor = GFX.bIndexed ? GFX.BlackIndex() : 0;
+
+	int curY = baseY;
+	int tileY = baseTileY;
+	for (uint32 dY = 0; dY < numRows; dY++, curY += tileHeight, tileY++) {
+		int curX = baseX;
+		int tileX = baseTileX;
+
+		// adjacent single color cells of the same color are filled as one span
+		int spanX = 0;
+		int spanWidth = 0;
+		Pixel spanColor = 0;
+
+		for (uint32 dX = 0; dX < numCols; dX++, curX += tileWidth, tileX++) {
+			gfx_sprite_t* sprite = BlackCell;
+			if (dY < mapRows) {
+				sprite = tilemap->tiles[tilemap->map[tileX + tileY * tilemap->width]];
+			}
+
+			if (TileCache.bValid) {
+				if (!bFull && TileCache.Drawn[dY][dX] == sprite) {
+					continue;
+				}
+				TileCache.Drawn[dY][dX] = sprite;
+			}
+
+			Blit.Fence(curY, curY + tileHeight);
+
+			uint8_t color = 0;
+			if (sprite == BlackCell || (sprite && sprite->width == tileWidth && sprite->height == tileHeight &&
+				TileClasses.Find(sprite, color) == TILE_UNIFORM)) {
+				Pixel fillColor = sprite == BlackCell ? blackColor : IndexColor<Pixel>(color);
+				if (spanWidth && spanColor == fillColor && spanX + spanWidth == curX) {
+					spanWidth += tileWidth;
+					continue;
+				}
+				if (spanWidth) {
+					FillTile(spanX, curY, spanWidth, tileHeight, spanColor);
+				}
+				spanX = curX;
+				spanWidth = tileWidth;
+				spanColor = fillColor;
+			} else if (sprite && TileClasses.Find(sprite, color) == TILE_UNIFORM) {
+				FillTile(curX, curY, sprite->width, sprite->height, IndexColor<Pixel>(color));
+			} else {
+				RenderSprite<true, false, Pixel>(sprite, curX, curY);
+			}
+		}
+
+		if (spanWidth) {
+			FillTile(spanX, curY, spanWidth, tileHeight, spanColor);
+		}
+	}
 }
 
 void gfx_Tilemap(gfx_tilemap_t *tilemap,
@@ -666,6 +1934,7 @@ void gfx_Tilemap(gfx_tilemap_t *tilemap,
 	int tileYMod = y_offset % tilemap->tile_height;
 
 	const int baseTileX = tileX;
+	const int baseTileY = tileY;
 
 	unsigned int numCols = tilemap->draw_width;
 	unsigned int numRows = tilemap->draw_height;
@@ -679,35 +1948,73 @@ void gfx_Tilemap(gfx_tilemap_t *tilemap,
 	}
 
 	// if we are rendering past the data, then render black
+	unsigned int mapRows = numRows;
 	if (numRows + tileY > tilemap->height) {
-		unsigned int newRows = tilemap->height - tileY;
-		unsigned int removedRows = numRows - newRows;
-		numRows = newRows;
-		uint16_t SwapColor = GFX.CurColor;
-		GFX.CurColor = 0;
-		gfx_FillRectangle(baseX, baseY + tilemap->tile_height * numRows, numCols * tilemap->tile_width, tilemap->tile_height * removedRows);
-		GFX.CurColor = SwapColor;
+		mapRows = tilemap->height - tileY;
 	}
 
-	int curY = baseY;
-	for (uint32 dY = 0; dY < numRows; dY++, curY += tilemap->tile_height, tileY++) {
-		int curX = baseX;
-		tileX = baseTileX;
-		for (uint32 dX = 0; dX < numCols; dX++, curX += tilemap->tile_width, tileX++) {
-			gfx_sprite_t* sprite = tilemap->tiles[tilemap->map[tileX + tileY * tilemap->width]];
-			gfx_Sprite(sprite, curX, curY);
+	// reuse what is on screen unless the tilemap, clip region or palette (of an RGB565 buffer) changed
+	bool bFull = true;
+	if (TileCache.bEnabled && numCols <= TilemapCache::MaxCols && numRows <= TilemapCache::MaxRows) {
+		if (TileCache.Matches(tilemap)) {
+			bFull = false;
+			if (x_offset != TileCache.XOffset || y_offset != TileCache.YOffset) {
+				bFull = !TileCache.Scroll(baseTileX, baseTileY, baseX, baseY, numCols, numRows,
+					(int)x_offset - (int)TileCache.XOffset, (int)y_offset - (int)TileCache.YOffset);
+			}
 		}
+
+		memcpy(&TileCache.Tilemap, tilemap, sizeof(TileCache.Tilemap));
+		TileCache.XOffset = x_offset;
+		TileCache.YOffset = y_offset;
+		TileCache.Clip[0] = GFX.Clip_MinX;
+		TileCache.Clip[1] = GFX.Clip_MinY;
+		TileCache.Clip[2] = GFX.Clip_MaxX;
+		TileCache.Clip[3] = GFX.Clip_MaxY;
+		memcpy(TileCache.Palette, GFX.Palette, sizeof(TileCache.Palette));
+		TileCache.TileX = baseTileX;
+		TileCache.TileY = baseTileY;
+		TileCache.BaseX = baseX;
+		TileCache.BaseY = baseY;
+		TileCache.NumCols = numCols;
+		TileCache.NumRows = numRows;
+		TileCache.bValid = true;
+	} else {
+		TileCache.Invalidate();
+	}
+
+	if (GFX.bIndexed) {
+		RenderTiles<uint8_t>(tilemap, baseX, baseY, baseTileX, baseTileY, numCols, numRows, mapRows, bFull);
+	} else {
+		RenderTiles<uint16_t>(tilemap, baseX, baseY, baseTileX, baseTileY, numCols, numRows, mapRows, bFull);
 	}
 }
 
+void gfx_SetTilemapDirtyTracking(bool bEnable) {
+	TileCache.bEnabled = bEnable;
+	TileCache.Invalidate();
+}
+
+void gfx_SetIndexedBuffer(bool bEnable) {
+	GFX.bIndexed = bEnable;
+	TileCache.Invalidate();
+}
+
 static void ResolveBufferToVRAM() {
 	const int ScreenOffset = (LCD_WIDTH_PX - gfx_lcdWidth) / 2;
 
 	// copy screen
 	for (int y = 215; y >= 0; y--) {
-		uint16_t* SrcColor = &BackBuffer()[gfx_lcdWidth * y];
 		uint16_t* DestColor = ((uint16_t*)GetVRAMAddress()) + LCD_WIDTH_PX * y + ScreenOffset;
-		memcpy(DestColor, SrcColor, gfx_lcdWidth * 2);
+		if (GFX.bIndexed) {
+			// resolved through a line, the first row of VRAM overlaps its own source
+			uint16_t line[gfx_lcdWidth];
+			ResolveLine(line, &IndexBuffer()[gfx_lcdWidth * y], gfx_lcdWidth);
+			memcpy(DestColor, line, gfx_lcdWidth * 2);
+		} else {
+			uint16_t* SrcColor = &BackBuffer()[gfx_lcdWidth * y];
+			memcpy(DestColor, SrcColor, gfx_lcdWidth * 2);
+		}
 	}
 
 	// black out sides
@@ -720,7 +2027,9 @@ static void ResolveBufferToVRAM() {
 }
 
 void kb_Scan_with_GetKey() {
-#ifdef TARGET_PRIZM
+	Blit.Wait();
+
+#if defined(TARGET_PRIZM) || TARGET_HOST
 	// before calling getkey we need to resolve the VRAM back into the system pitch:
 	ResolveBufferToVRAM();
 #endif
@@ -729,6 +2038,9 @@ void kb_Scan_with_GetKey() {
 	GetKey(&key);
 	kb_Scan();
 
+	// the OS may have drawn over the back buffer
+	TileCache.Invalidate();
+
 	// clear VRAM and draw frame cause we mind have went to menu, onus is on app to redraw screen
 	Bdisp_Fill_VRAM(0, 3);
 	DrawFrame(0);
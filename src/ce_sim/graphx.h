@@ -380,6 +380,24 @@ void gfx_Tilemap(gfx_tilemap_t *tilemap,
                  uint24_t x_offset,
                  uint24_t y_offset);
 
+/**
+ * Prizm port: enables or disables dirty cell tracking in gfx_Tilemap (enabled by default).
+ *
+ * While enabled, gfx_Tilemap only redraws the cells whose tile changed or that were drawn
+ * over since the previous call, when the clip region and palette are the same. A change of
+ * offsets moves the pixels still on screen and draws only the cells that scrolled in.
+ */
+void gfx_SetTilemapDirtyTracking(bool enable);
+
+/**
+ * Prizm port: draws into an 8 bit buffer of palette indices instead of RGB565 (disabled by default).
+ *
+ * The palette is resolved once per pixel as the buffer is blitted, so palette changes show up on
+ * the next blit without redrawing, and gfx_Tilemap keeps its cells across them. Switch between
+ * frames, the buffer contents are not converted.
+ */
+void gfx_SetIndexedBuffer(bool enable);
+
 /**
  * Draws an unclipped tilemap given an initialized tilemap structure.
  *
@@ -522,6 +540,37 @@ void gfx_SetPalette(void *palette,
                     uint24_t size,
                     uint24_t offset);
 
+/**
+ * Prizm port: draws the sprites in a block of sprite data, such as a whole sprite appvar, from
+ * resolved RGB565 colors.
+ *
+ * Each sprite in the block is resolved on its first draw into a fixed size cache instead of
+ * looking up each pixel in the palette. The cache starts over when it fills or the palette
+ * changes. If there is not enough memory for it, sprites are drawn through the palette as before.
+ * @param block Which block this is, up to 4. Registering a block again replaces it.
+ * @param data Start of the sprite data.
+ * @param size Size of the block in bytes.
+ */
+void gfx_ResolveSprites(unsigned int block, void *data, unsigned int size);
+
+/**
+ * Prizm port: classifies a tileset so gfx_Tilemap can fill single color tiles.
+ *
+ * @param tiles First tile sprite, the tiles are laid out one after the other.
+ * @param count Number of tiles.
+ * @param stride Size of each tile sprite in bytes.
+ */
+void gfx_ClassifyTiles(void *tiles, unsigned int count, unsigned int stride);
+
+/**
+ * Prizm port: indexes the rows of an RLE sprite so clipped drawing skips hidden rows directly.
+ *
+ * Up to 8 sprites are indexed, the oldest is dropped past that. The sprite data must not change
+ * while it is indexed.
+ * @param sprite Sprite to index, indexing it again rebuilds its rows.
+ */
+void gfx_IndexRLETSprite(gfx_rletsprite_t *sprite);
+
 /**
  * Fills the screen with a given palette index.
  *
@@ -882,6 +931,9 @@ void gfx_Wait(void);
  * Copies the input buffer to the opposite buffer.
  *
  * No clipping is performed; as it is a copy not a draw.
+ *
+ * Prizm port: returns once the transfer has started. Like after gfx_SwapDraw(), drawing
+ * functions wait for it, but only when they draw over lines still being sent.
  * @param src drawing location to copy from.
  * @see gfx_location_t
  */
@@ -891,6 +943,8 @@ void gfx_Blit(gfx_location_t src);
  * Copies lines from the input buffer to the opposite buffer.
  *
  * No clipping is performed; as it is a copy not a draw.
+ *
+ * Prizm port: returns once the transfer has started, see gfx_Blit().
  * @param src drawing location to copy from.
  * @param y_loc Y Location to begin copying at.
  * @param num_lines Number of lines to copy.
@@ -900,6 +954,22 @@ void gfx_BlitLines(gfx_location_t src,
                    uint8_t y_loc,
                    uint8_t num_lines);
 
+/**
+ * Prizm port: queues lines of the buffer to be sent by the next gfx_FlushLines().
+ *
+ * Lets the updates of a frame, such as the playfield and each changed part of the HUD, go out
+ * together at the end of it. gfx_Blit() sends anything queued along with the whole buffer.
+ * @param y_loc Y Location to begin copying at.
+ * @param num_lines Number of lines to copy.
+ */
+void gfx_QueueLines(uint8_t y_loc, uint8_t num_lines);
+
+/**
+ * Prizm port: sends the lines queued with gfx_QueueLines(). Ranges that touch or overlap go in
+ * one transfer, and lines that were not queued are never sent.
+ */
+void gfx_FlushLines(void);
+
 /**
  * Transfers a rectangle from the source graphics buffer to the opposite
  * buffer.
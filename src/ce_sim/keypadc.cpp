@@ -4,10 +4,12 @@
 #include "ce_sim.h"
 #include "keypadc.h"
 
+#if !TARGET_HOST
 #include "fxcg/system.h"
+#endif
 
 extern "C" {
-#if !TARGET_WINSIM
+#if !TARGET_WINSIM && !TARGET_HOST
 	// returns true if the key is down, false if up
 	bool keyDown_fast(unsigned char keyCode) {
 		static const unsigned short* keyboard_register = (unsigned short*)0xA44B0000;
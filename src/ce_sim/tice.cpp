@@ -4,7 +4,9 @@
 #include "ce_sim.h"
 #include "tice.h"
 
+#if !TARGET_HOST
 #include "fxcg/system.h"
+#endif
 
 extern "C" {
 	extern bool keyDown_fast(unsigned char keyCode);
@@ -22,6 +22,8 @@ extern "C" {
  * Hardware & custom macros/functions
  */
 
+// the host C library already declares these
+#if !TARGET_HOST
 /**
  * Returns a pseudo-random 32-bit integer.
  *
@@ -36,6 +38,7 @@ uint32_t random(void);
  * @param seed the seed value
  */
 void srandom(uint32_t seed);
+#endif
 
 /**
  * Returns a pseudo-random integer in the range of \p min to \p max (inclusive).
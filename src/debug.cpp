@@ -1,7 +1,9 @@
 #include "platform.h"
 #include "debug.h"
 
+#if !TARGET_HOST
 #include "calctype/fonts/arial_small/arial_small.c"
+#endif
 
 static int printY = 0;
 void reset_printf() {
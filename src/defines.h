@@ -119,6 +119,20 @@ typedef struct {
 
 extern game_t game;
 
+/* Step scheduler defines */
+
+// the simulation runs a step every 4 ticks of the 128 Hz RTC, 32 steps a second
+#define SIM_STEP_TICKS 4
+
+// steps run without drawing when behind before the rest of the time is dropped
+#define MAX_FRAME_SKIP 3
+
+// fast forward: F6 cycles through running 1, 2, 4 and 8 steps a frame without waiting on the RTC
+#define TURBO_KEY       29
+#define TURBO_MAX_STEPS 8
+
+extern uint8_t turbo_steps;
+
 /* Tilemap defines */
 
 #define TILE_DATA_SIZE 258
@@ -142,7 +156,7 @@ extern game_t game;
 
 #define oiram_collision(a, b, c, d) gfx_CheckRectangleHotspot(oiram.x, oiram.y, OIRAM_HITBOX_WIDTH, oiram.hitbox.height, a, b, c, d)
 
-#if TARGET_PRIZM
+#if TARGET_PRIZM || TARGET_HOST
 #define EXIT_KEY kb_Square
 #define EXIT_KEY_GROUP 2
 #else
@@ -7,6 +7,9 @@
 #include "loadscreen.h"
 #include "images.h"
 #include "oiram.h"
+#include "pool.h"
+#include "grid.h"
+#include "events.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -29,24 +32,26 @@ uint8_t num_thwomps = 0;
 uint8_t num_flames = 0;
 uint8_t num_simple_enemies = 0;
 
+uint16_t spawning = NO_SPAWN;
+
 // types of shell enemies
 enum { KOOPA_GREEN, KOOPA_RED, KOOPA_GREEN_FLY, KOOPA_RED_FLY, KOOPA_BONES, SPIKE };
 
 void add_goomba(uint8_t *tile) {
     simple_move_t *e = add_simple_mover(tile);
 
-    e->hitbox.width = GOOMBA_WIDTH;
-    e->hitbox.height = GOOMBA_HEIGHT;
-    e->vx = -1;
+    movers.hitbox[e->slot].width = GOOMBA_WIDTH;
+    movers.hitbox[e->slot].height = GOOMBA_HEIGHT;
+    movers.vx[e->slot] = -1;
     e->type = GOOMBA_TYPE;
 }
 
 void add_reswob(uint8_t *tile) {
     simple_move_t *e = add_simple_mover(tile);
 
-    e->hitbox.width = RESWOB_WIDTH;
-    e->hitbox.height = RESWOB_HEIGHT;
-    e->vx = -1;
+    movers.hitbox[e->slot].width = RESWOB_WIDTH;
+    movers.hitbox[e->slot].height = RESWOB_HEIGHT;
+    movers.vx[e->slot] = -1;
     e->type = RESWOB_TYPE;
 }
 
@@ -55,53 +60,55 @@ void add_boo(uint8_t *tile) {
     unsigned int x, y;
 
     if (num_boos > MAX_BOOS - 1) {
+        sweep_table(boo, num_boos);
+        invalidate_grids();
+        if (num_boos > MAX_BOOS - 1) {
+            return;
+        }
+    }
+    if (pool_full(POOL_BOOS)) {
         return;
     }
 
     tile_to_abs_xy_pos(tile, &x, &y);
 
-    boo[num_boos] = e = malloc(sizeof(boo_t));
+    boo[num_boos] = e = pool_alloc(POOL_BOOS);
 
     e->x = x;
     e->y = y;
     e->vy = -1;
     e->dir = false;
     e->count = 0;
+    e->spawn = spawning;
+    grid_added(GRID_BOOS, num_boos);
     num_boos++;
 }
 
 void remove_boo(uint8_t i) {
     boo_t *e;
-    uint8_t num_boos_less;
 
-    if (!num_boos) {
+    if (i >= num_boos || !(e = boo[i])) {
         return;
     }
 
-    e = boo[i];
-    num_boos_less = num_boos--;
-
-    for(; i < num_boos_less; i++) {
-        boo[i] = boo[i+1];
-    }
-
-    free(e);
+    clear_table_entry(boo, num_boos, i);
+    pool_free(POOL_BOOS, e);
 }
 
 void add_shell_enemy(uint8_t *tile, uint8_t type) {
     simple_move_t *e = add_simple_mover(tile);
 
-    e->hitbox.width = 15;
-    e->hitbox.height = 26;
-    e->vx = -1;
+    movers.hitbox[e->slot].width = 15;
+    movers.hitbox[e->slot].height = 26;
+    movers.vx[e->slot] = -1;
     switch(type) {
         case KOOPA_GREEN:
             e->type = KOOPA_GREEN_TYPE;
-            e->smart = false;
+            movers.smart[e->slot] = false;
             break;
         case KOOPA_RED:
             e->type = KOOPA_RED_TYPE;
-            e->smart = true;
+            movers.smart[e->slot] = true;
             break;
         case KOOPA_GREEN_FLY:
             e->type = KOOPA_GREEN_FLY_TYPE;
@@ -109,18 +116,18 @@ void add_shell_enemy(uint8_t *tile, uint8_t type) {
         case KOOPA_RED_FLY:
             e->type = KOOPA_RED_FLY_TYPE;
         FLYING_TYPE:
-            e->smart = true;
-            e->vx = 0;
-            e->vy = 1;
-            e->is_flyer = true;
+            movers.smart[e->slot] = true;
+            movers.vx[e->slot] = 0;
+            movers.vy[e->slot] = 1;
+            movers.is_flyer[e->slot] = true;
             break;
         case KOOPA_BONES:
             e->type = KOOPA_BONES_TYPE;
-            e->smart = true;
+            movers.smart[e->slot] = true;
             break;
         default:
-            e->hitbox.height = SPIKE_HEIGHT;
-            e->smart = false;
+            movers.hitbox[e->slot].height = SPIKE_HEIGHT;
+            movers.smart[e->slot] = false;
             e->type = SPIKE_TYPE;
             break;
     }
@@ -131,11 +138,18 @@ void add_chomper(uint8_t *tile, bool throws_fire) {
     unsigned int x, y;
 
     if (num_chompers > MAX_CHOMPERS - 1) {
+        sweep_table(chomper, num_chompers);
+        invalidate_grids();
+        if (num_chompers > MAX_CHOMPERS - 1) {
+            return;
+        }
+    }
+    if (pool_full(POOL_CHOMPERS)) {
         return;
     }
 
     tile_to_abs_xy_pos(tile, &x, &y);
-    chomper[num_chompers] = e = malloc(sizeof(chomper_t));
+    chomper[num_chompers] = e = pool_alloc(POOL_CHOMPERS);
 
     e->x = x + TILE_WIDTH/2;
     e->y = y;
@@ -143,25 +157,20 @@ void add_chomper(uint8_t *tile, bool throws_fire) {
     e->vy = -2;
     e->throws_fire = throws_fire;
     e->count = 0;
+    e->spawn = spawning;
+    grid_added(GRID_CHOMPERS, num_chompers);
     num_chompers++;
 }
 
 void remove_chomper(uint8_t i) {
     chomper_t *e;
-    uint8_t num_chompers_less;
 
-    if (!num_chompers) {
+    if (i >= num_chompers || !(e = chomper[i])) {
         return;
     }
 
-    e = chomper[i];
-    num_chompers_less = num_chompers--;
-
-    for(; i < num_chompers_less; i++) {
-        chomper[i] = chomper[i+1];
-    }
-
-    free(e);
+    clear_table_entry(chomper, num_chompers, i);
+    pool_free(POOL_CHOMPERS, e);
 }
 
 void add_flame(uint8_t *tile) {
@@ -169,37 +178,39 @@ void add_flame(uint8_t *tile) {
     unsigned int x, y;
 
     if (num_flames > MAX_FLAMES - 1) {
+        sweep_table(flame, num_flames);
+        invalidate_grids();
+        if (num_flames > MAX_FLAMES - 1) {
+            return;
+        }
+    }
+    if (pool_full(POOL_FLAMES)) {
         return;
     }
 
     tile_to_abs_xy_pos(tile, &x, &y);
 
-    flame[num_flames] = e = malloc(sizeof(flame_t));
+    flame[num_flames] = e = pool_alloc(POOL_FLAMES);
 
     e->x = x;
     e->y = y;
     e->start_y = y;
     e->vy = -15;
     e->count = 0;
+    e->spawn = spawning;
+    grid_added(GRID_FLAMES, num_flames);
     num_flames++;
 }
 
 void remove_flame(uint8_t i) {
     flame_t *e;
-    uint8_t num_flames_less;
 
-    if (!num_flames) {
+    if (i >= num_flames || !(e = flame[i])) {
         return;
     }
 
-    e = flame[i];
-    num_flames_less = num_flames--;
-
-    for(; i < num_flames_less; i++) {
-        flame[i] = flame[i+1];
-    }
-
-    free(e);
+    clear_table_entry(flame, num_flames, i);
+    pool_free(POOL_FLAMES, e);
 }
 
 void add_thwomp(uint8_t *tile) {
@@ -207,50 +218,58 @@ void add_thwomp(uint8_t *tile) {
     unsigned int x, y;
 
     if (num_thwomps > MAX_THWOMPS - 1) {
+        sweep_table(thwomp, num_thwomps);
+        invalidate_grids();
+        if (num_thwomps > MAX_THWOMPS - 1) {
+            return;
+        }
+    }
+    if (pool_full(POOL_THWOMPS)) {
         return;
     }
 
     tile_to_abs_xy_pos(tile, &x, &y);
 
-    thwomp[num_thwomps] = e = malloc(sizeof(thwomp_t));
+    thwomp[num_thwomps] = e = pool_alloc(POOL_THWOMPS);
 
     e->x = x + 4;
     e->y = y;
     e->start_y = y;
     e->vy = 0;
     e->count = 0;
+    e->spawn = spawning;
+    grid_added(GRID_THWOMPS, num_thwomps);
     num_thwomps++;
 }
 
 void remove_thwomp(uint8_t i) {
     thwomp_t *e;
-    uint8_t num_thowmps_less;
 
-    if (!num_thwomps) {
+    if (i >= num_thwomps || !(e = thwomp[i])) {
         return;
     }
 
-    e = thwomp[i];
-    num_thowmps_less = num_thwomps--;
-
-    for(; i < num_thowmps_less; i++) {
-        thwomp[i] = thwomp[i+1];
-    }
-
-    free(e);
+    clear_table_entry(thwomp, num_thwomps, i);
+    pool_free(POOL_THWOMPS, e);
 }
 
 enemy_t *add_simple_enemy(uint8_t *tile, uint8_t type) {
     enemy_t *enemy;
     unsigned int x, y;
 
-    if (num_simple_enemies > MAX_SIMPLE_ENEMY - 1) {
-        remove_simple_enemy(0);
+    // full of live enemies, drop the oldest
+    if (num_simple_enemies > MAX_SIMPLE_ENEMY - 1 || pool_full(POOL_SIMPLE_ENEMIES)) {
+        sweep_table(simple_enemy, num_simple_enemies);
+        if (num_simple_enemies > MAX_SIMPLE_ENEMY - 1 || pool_full(POOL_SIMPLE_ENEMIES)) {
+            remove_simple_enemy(0);
+            sweep_table(simple_enemy, num_simple_enemies);
+        }
+        invalidate_grids();
     }
 
     tile_to_abs_xy_pos(tile, &x, &y);
 
-    enemy = simple_enemy[num_simple_enemies] = malloc(sizeof(enemy_t));
+    enemy = simple_enemy[num_simple_enemies] = pool_alloc(POOL_SIMPLE_ENEMIES);
 
     enemy->vx = 0;
     enemy->vy = 0;
@@ -283,26 +302,165 @@ enemy_t *add_simple_enemy(uint8_t *tile, uint8_t type) {
     }
 
     enemy->type = type;
+    enemy->spawn = spawning;
+    grid_added(GRID_SIMPLE_ENEMIES, num_simple_enemies);
     num_simple_enemies++;
     return enemy;
 }
 
 void remove_simple_enemy(uint8_t i) {
     enemy_t *e;
-    uint8_t num_simple_enemies_less;
 
-    if (!num_simple_enemies) {
+    if (i >= num_simple_enemies || !(e = simple_enemy[i])) {
         return;
     }
 
-    e = simple_enemy[i];
-    num_simple_enemies_less = num_simple_enemies--;
+    clear_table_entry(simple_enemy, num_simple_enemies, i);
+    pool_free(POOL_SIMPLE_ENEMIES, e);
+}
 
-    for(; i < num_simple_enemies_less; i++) {
-        simple_enemy[i] = simple_enemy[i+1];
+// enemies are spawned from this index when the window around oiram gets near their column instead
+// of all at level start, so the tables only hold what is near the player. the spawn tiles are
+// cleared from the map at load and indexed by column, in map order within a column. a spawned
+// enemy is moved from the end of its table to after the entries spawned before it in map order,
+// so the tables are in the same order as when every enemy was added at load
+#define MAX_SPAWNS 512
+#define SPAWN_DISTANCE (360 + 2*TILE_WIDTH)
+
+typedef struct {
+    uint16_t offset;    // in tilemap.map
+    uint8_t tile;
+    uint8_t column;
+} spawn_t;
+
+static spawn_t spawns[MAX_SPAWNS];          // in map order
+static uint16_t spawn_order[MAX_SPAWNS];    // spawns by column
+static uint16_t spawn_start[256 + 1];
+static bool column_spawned[256];
+static int spawn_first;
+static int spawn_last;
+
+static void spawn_tile(uint8_t *this, uint8_t tile) {
+    switch(tile) {
+        case 0x61:
+            add_simple_enemy(this, CANNONBALL_DOWN_CREATOR_TYPE);
+            break;
+        case 0x53:
+            add_simple_enemy(this, CANNONBALL_UP_CREATOR_TYPE);
+            break;
+        case 0x46:
+            add_simple_enemy(this, BULLET_CREATOR_TYPE);
+            break;
+        case TILE_E_RESWOB:
+            add_reswob(this);
+            break;
+        case TILE_E_FISH:
+            add_simple_enemy(this, FISH_TYPE);
+            break;
+        case TILE_E_GOOMBA:
+            add_goomba(this);
+            break;
+        case TILE_E_SPIKE:
+        case TILE_E_GREEN_KOOPA:
+        case TILE_E_RED_KOOPA:
+        case TILE_E_GREEN_FLY_KOOPA:
+        case TILE_E_RED_FLY_KOOPA:
+        case TILE_E_BONES_KOOPA:
+            add_shell_enemy(this, tile - TILE_E_GREEN_KOOPA);
+            break;
+        case TILE_E_THWOMP:
+            add_thwomp(this);
+            break;
+        case TILE_E_LAVA_FIREBALL:
+            add_flame(this);
+            break;
+        case TILE_E_CHOMPER:
+        case TILE_E_FIRE_CHOMPER:
+            add_chomper(this + tilemap.width, tile == TILE_E_FIRE_CHOMPER);
+            break;
+        case TILE_E_BOO:
+            add_boo(this);
+            break;
+        default:
+            break;
+    }
+}
+
+uint8_t spawn_pool(uint8_t tile) {
+    switch(tile) {
+        case 0x61:
+        case 0x53:
+        case 0x46:
+        case TILE_E_FISH:
+            return POOL_SIMPLE_ENEMIES;
+        case TILE_E_RESWOB:
+        case TILE_E_GOOMBA:
+        case TILE_E_SPIKE:
+        case TILE_E_GREEN_KOOPA:
+        case TILE_E_RED_KOOPA:
+        case TILE_E_GREEN_FLY_KOOPA:
+        case TILE_E_RED_FLY_KOOPA:
+        case TILE_E_BONES_KOOPA:
+            return POOL_SIMPLE_MOVERS;
+        case TILE_E_THWOMP:
+            return POOL_THWOMPS;
+        case TILE_E_LAVA_FIREBALL:
+            return POOL_FLAMES;
+        case TILE_E_CHOMPER:
+        case TILE_E_FIRE_CHOMPER:
+            return POOL_CHOMPERS;
+        case TILE_E_BOO:
+            return POOL_BOOS;
+        default:
+            return NUM_POOLS;
     }
+}
+
+// add_* append the entry, which is moved back past the entries from later spawns and the ones added
+// during play. it isn't there when the table was full
+#define place_spawned(table, count, grid) { \
+    uint8_t last = (count) - 1, pos; \
+    if ((count) && (table)[last] && (table)[last]->spawn == spawning) { \
+        void *spawned = (table)[last]; \
+        for (pos = 0; pos < last && (!(table)[pos] || (table)[pos]->spawn < spawning); pos++); \
+        if (pos < last) { \
+            memmove(&(table)[pos + 1], &(table)[pos], (last - pos) * sizeof((table)[0])); \
+            (table)[pos] = spawned; \
+            invalidate_grid(grid); \
+        } \
+    } \
+}
 
-    free(e);
+static void spawn_indexed(uint16_t index) {
+    spawn_t *spawn = &spawns[index];
+
+    spawning = index;
+    spawn_tile(tilemap.map + spawn->offset, spawn->tile);
+    switch(spawn->tile) {
+        case 0x61:
+        case 0x53:
+        case 0x46:
+        case TILE_E_FISH:
+            place_spawned(simple_enemy, num_simple_enemies, GRID_SIMPLE_ENEMIES);
+            break;
+        case TILE_E_THWOMP:
+            place_spawned(thwomp, num_thwomps, GRID_THWOMPS);
+            break;
+        case TILE_E_LAVA_FIREBALL:
+            place_spawned(flame, num_flames, GRID_FLAMES);
+            break;
+        case TILE_E_CHOMPER:
+        case TILE_E_FIRE_CHOMPER:
+            place_spawned(chomper, num_chompers, GRID_CHOMPERS);
+            break;
+        case TILE_E_BOO:
+            place_spawned(boo, num_boos, GRID_BOOS);
+            break;
+        default:
+            place_spawned(simple_mover, num_simple_movers, GRID_SIMPLE_MOVERS);
+            break;
+    }
+    spawning = NO_SPAWN;
 }
 
 void get_enemies(void) {
@@ -310,8 +468,16 @@ void get_enemies(void) {
     uint8_t height = tilemap.height;
     unsigned int j;
     unsigned int loop = width * height;
+    unsigned int num_spawns = 0;
+    uint16_t fill[256];
+    uint8_t column = 0;
 
-    for(j = 0; j < loop; j++) {
+    memset(spawn_start, 0, sizeof(spawn_start));
+    memset(column_spawned, 0, sizeof(column_spawned));
+    spawn_first = 0;
+    spawn_last = -1;
+
+    for(j = 0; j < loop; j++, column = (column + 1 == width) ? 0 : column + 1) {
         uint8_t *this = tilemap.map + j;
         uint8_t tile = *this;
         int8_t tmp1, tmp2;
@@ -325,9 +491,9 @@ void get_enemies(void) {
                     bool at_neg_1 = tmp2 == -1;
                     for (tmp1=-1; tmp1<2; tmp1++) {
                         tile_pntr = (this+tmp1+off);
+                        if ((tile_pntr < tilemap.map) || (tile_pntr >= tilemap.map + loop)) continue; // prevents checking outside tilemap
                         tile = *tile_pntr;
                         if (tile == TILE_WATER || tile == TILE_WATER_COIN || (at_neg_1 && tile == TILE_WATER_TOP)) {
-                            if ((tile_pntr < tilemap.map) || (tile_pntr > tilemap.map + loop)) continue; // prevents checking outside tilemap
                             if (((j % width) - ((tile_pntr - tilemap.map) % width)) > 1) continue; // prevents checking other side
                             *this = TILE_WATER_COIN;
                             goto end_loops;
@@ -336,57 +502,92 @@ void get_enemies(void) {
                 }
             end_loops:
                 break;
-            case 0x61:
-                add_simple_enemy(this, CANNONBALL_DOWN_CREATOR_TYPE);
-                break;
-            case 0x53:
-                add_simple_enemy(this, CANNONBALL_UP_CREATOR_TYPE);
-                break;
-            case 0x46:
-                add_simple_enemy(this, BULLET_CREATOR_TYPE);
-                break;
             case TILE_E_ORIAM_START:
                 tile_to_abs_xy_pos(this, (unsigned int*)&oiram.x, (unsigned int*)&oiram.y);
                 if (oiram.flags & FLAG_OIRAM_BIG) {
                     oiram.y -= TILE_HEIGHT + 2;
                 }
-                goto SET_EMPTY_TILE;
-            case TILE_E_RESWOB:
-                add_reswob(this);
-                goto SET_EMPTY_TILE;
+                *this = TILE_EMPTY;
+                break;
+            // cannons stay in the map
+            case 0x61:
+            case 0x53:
+            case 0x46:
+                goto ADD_SPAWN;
             case TILE_E_FISH:
-                add_simple_enemy(this, FISH_TYPE);
                 *this = TILE_WATER;
-                break;
+                goto ADD_SPAWN;
+            case TILE_E_LAVA_FIREBALL:
+                *this = TILE_LAVA_TOP;
+                goto ADD_SPAWN;
+            case TILE_E_RESWOB:
             case TILE_E_GOOMBA:
-                add_goomba(this);
-                goto SET_EMPTY_TILE;
             case TILE_E_SPIKE:
             case TILE_E_GREEN_KOOPA:
             case TILE_E_RED_KOOPA:
             case TILE_E_GREEN_FLY_KOOPA:
             case TILE_E_RED_FLY_KOOPA:
             case TILE_E_BONES_KOOPA:
-                add_shell_enemy(this, tile - TILE_E_GREEN_KOOPA);
-                goto SET_EMPTY_TILE;
             case TILE_E_THWOMP:
-                add_thwomp(this);
-                goto SET_EMPTY_TILE;
-            case TILE_E_LAVA_FIREBALL:
-                add_flame(this);
-                *this = TILE_LAVA_TOP;
-                break;
             case TILE_E_CHOMPER:
             case TILE_E_FIRE_CHOMPER:
-                add_chomper(this + width, tile == TILE_E_FIRE_CHOMPER);
-                goto SET_EMPTY_TILE;
             case TILE_E_BOO:
-                add_boo(this);
-            SET_EMPTY_TILE:
                 *this = TILE_EMPTY;
+            ADD_SPAWN:
+                // more than the index holds are spawned now, after every indexed one
+                if (num_spawns == MAX_SPAWNS) {
+                    spawning = MAX_SPAWNS;
+                    spawn_tile(this, tile);
+                    spawning = NO_SPAWN;
+                    break;
+                }
+                spawns[num_spawns].offset = j;
+                spawns[num_spawns].tile = tile;
+                spawns[num_spawns].column = column;
+                spawn_start[column + 1]++;
+                num_spawns++;
                 break;
             default:
                 break;
         }
     }
+
+    // counting sort by column, which keeps map order within each column
+    for(j = 0; j < 256; j++) {
+        spawn_start[j + 1] += spawn_start[j];
+        fill[j] = spawn_start[j];
+    }
+    for(j = 0; j < num_spawns; j++) {
+        spawn_order[fill[spawns[j].column]++] = j;
+    }
+}
+
+void spawn_enemies(void) {
+    int t_x = viewport_x();
+    int first = t_x - SPAWN_DISTANCE;
+    int last = t_x + SPAWN_DISTANCE;
+    int column;
+
+    first = first < 0 ? 0 : first / TILE_WIDTH;
+    last = last < 0 ? -1 : last / TILE_WIDTH;
+    if (last > tilemap.width - 1) {
+        last = tilemap.width - 1;
+    }
+
+    // nothing new unless the window moved to another column
+    if (first == spawn_first && last == spawn_last) {
+        return;
+    }
+    spawn_first = first;
+    spawn_last = last;
+
+    for(column = first; column <= last; column++) {
+        if (!column_spawned[column]) {
+            unsigned int k, end = spawn_start[column + 1];
+            column_spawned[column] = true;
+            for(k = spawn_start[column]; k < end; k++) {
+                spawn_indexed(spawn_order[k]);
+            }
+        }
+    }
 }
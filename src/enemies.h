@@ -8,8 +8,20 @@
 #include <stdbool.h>
 #include "graphx.h"
 
+// clears the spawn tiles from the map and indexes them, sets oiram's start location
 void get_enemies(void);
 
+// spawns the enemies indexed by get_enemies whose columns the window around oiram has reached
+void spawn_enemies(void);
+
+// the index of the map spawn being added, which the add functions record in the entry's spawn
+// so spawn_enemies can put it in map order. NO_SPAWN for entries added during play
+#define NO_SPAWN 0xFFFF
+extern uint16_t spawning;
+
+// the pool the enemy of a spawn tile is allocated from, NUM_POOLS for any other tile
+uint8_t spawn_pool(uint8_t tile);
+
 void remove_flame(uint8_t i);
 void remove_thwomp(uint8_t i);
 void remove_chomper(uint8_t i);
@@ -30,6 +42,7 @@ typedef struct {
     int8_t vy;
     bool throws_fire;
     uint8_t count;
+    uint16_t spawn;
 } chomper_t;
 
 extern chomper_t *chomper[MAX_CHOMPERS];
@@ -42,6 +55,7 @@ typedef struct {
     int x, y;
     int8_t vy;
     uint8_t count;
+    uint16_t spawn;
 } flame_t;
 
 extern flame_t *flame[MAX_FLAMES];
@@ -54,6 +68,7 @@ typedef struct {
     int x, y;
     int8_t vy;
     uint8_t count;
+    uint16_t spawn;
 } thwomp_t;
 
 extern thwomp_t *thwomp[MAX_THWOMPS];
@@ -66,6 +81,7 @@ typedef struct {
     int8_t vy;
     bool dir;
     uint8_t count;
+    uint16_t spawn;
 } boo_t;
 
 extern boo_t *boo[MAX_BOOS];
@@ -80,6 +96,7 @@ typedef struct {
     uint8_t type;
     uint8_t counter;
     gfx_sprite_t *sprite;
+    uint16_t spawn;
 } enemy_t;
 
 enum simple_enemy_type {
@@ -11,6 +11,8 @@
 #include "powerups.h"
 #include "enemies.h"
 #include "simple_mover.h"
+#include "pool.h"
+#include "grid.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -26,17 +28,111 @@
 
 bool something_died = false;
 
-// only handle if somewhat within view; otherwise we can just ignore it
-bool in_viewport(int x, int y) {
-    int t_x, t_y;
+// the sprites the update pass leaves for the draw pass, in the order they go on screen. clip
+// entries set the clip region from x, y to x2, y2 for the sprites after them
+enum event_draw_types {
+    DRAW_SPRITE=0,
+    DRAW_RLET_SPRITE,
+    DRAW_OPAQUE_SPRITE,
+    DRAW_CLIP
+};
+
+typedef struct {
+    uint8_t type;
+    void *sprite;
+    int16_t x, y;
+    int16_t x2, y2;
+} event_draw_t;
+
+// a full list is drawn and emptied during the update, the sprites go on screen in the same order
+#define MAX_EVENT_DRAWS 64
+
+static event_draw_t event_draw[MAX_EVENT_DRAWS];
+static unsigned int num_event_draws;
+
+// the frame of this update is drawn, nothing is kept otherwise
+static bool event_drawing;
+
+static void draw_event_list(void) {
+    event_draw_t *cur = event_draw;
+    event_draw_t *end = event_draw + num_event_draws;
+
+    for (; cur < end; cur++) {
+        switch (cur->type) {
+            case DRAW_SPRITE:
+                gfx_TransparentSprite(cur->sprite, cur->x, cur->y);
+                break;
+            case DRAW_RLET_SPRITE:
+                gfx_RLETSprite(cur->sprite, cur->x, cur->y);
+                break;
+            case DRAW_OPAQUE_SPRITE:
+                gfx_Sprite(cur->sprite, cur->x, cur->y);
+                break;
+            case DRAW_CLIP:
+                gfx_SetClipRegion(cur->x, cur->y, cur->x2, cur->y2);
+                break;
+        }
+    }
+    gfx_SetClipRegion(0, 0, X_PXL_MAX, Y_PXL_MAX);
+}
 
-    if (oiram.failed) {
-        t_x = oiram.fail_x;
-        t_y = oiram.fail_y;
-    } else {
-        t_x = oiram.x;
-        t_y = oiram.y;
+static event_draw_t *emit_draw(uint8_t type, void *sprite, int x, int y) {
+    event_draw_t *draw;
+
+    if (!event_drawing) {
+        return NULL;
+    }
+    if (num_event_draws == MAX_EVENT_DRAWS) {
+        // the clip the list ended with goes on to the sprites after it
+        event_draw_t *clip = NULL;
+        for (draw = event_draw; draw < event_draw + MAX_EVENT_DRAWS; draw++) {
+            if (draw->type == DRAW_CLIP) {
+                clip = draw;
+            }
+        }
+        draw_event_list();
+        num_event_draws = 0;
+        if (clip) {
+            event_draw[num_event_draws++] = *clip;
+        }
+    }
+    draw = &event_draw[num_event_draws++];
+    draw->type = type;
+    draw->sprite = sprite;
+    draw->x = (int16_t)x;
+    draw->y = (int16_t)y;
+    return draw;
+}
+
+static void emit_sprite(gfx_sprite_t *sprite, int x, int y) {
+    emit_draw(DRAW_SPRITE, sprite, x, y);
+}
+
+static void emit_rlet_sprite(gfx_rletsprite_t *sprite, int x, int y) {
+    emit_draw(DRAW_RLET_SPRITE, sprite, x, y);
+}
+
+static void emit_opaque_sprite(gfx_sprite_t *sprite, int x, int y) {
+    emit_draw(DRAW_OPAQUE_SPRITE, sprite, x, y);
+}
+
+static void emit_clip(int x1, int y1, int x2, int y2) {
+    event_draw_t *draw = emit_draw(DRAW_CLIP, NULL, x1, y1);
+    if (draw) {
+        draw->x2 = (int16_t)x2;
+        draw->y2 = (int16_t)y2;
     }
+}
+
+int viewport_x(void) {
+    return oiram.failed ? oiram.fail_x : oiram.x;
+}
+
+// only handle if somewhat within view; otherwise we can just ignore it. next_active walks the same window
+bool in_viewport(int x, int y) {
+    int t_x = viewport_x();
+    int t_y = oiram.failed ? oiram.fail_y : oiram.y;
+
     if (x - 360 >= t_x) {
         return false;
     } else
@@ -55,21 +151,29 @@ bool in_viewport(int x, int y) {
 // gloabl used to handle events that aren't oiram
 bool handling_events;
 
-void handle_pending_events(void) {
+void update_pending_events(bool draw) {
     uint8_t i;
     int x, y;
     int rel_x, rel_y;
 
     handling_events = true;
+    event_drawing = draw;
+    num_event_draws = 0;
 
     oiram.rel_x = oiram.x - oiram.scrollx;
     oiram.rel_y = oiram.y - oiram.scrolly;
 
+    spawn_enemies();
+
     if (num_thwomps) {
-        for(i = 0; i < num_thwomps; i++) {
+        for(i = next_active(GRID_THWOMPS, -1); i < num_thwomps; i = next_active(GRID_THWOMPS, i)) {
             thwomp_t *cur = thwomp[i];
             int8_t tmp_vy;
 
+            if (!cur) {
+                continue;
+            }
+
             x = cur->x;
             y = cur->y;
 
@@ -81,7 +185,7 @@ void handle_pending_events(void) {
             rel_x = x - oiram.scrollx;
             rel_y = y - oiram.scrolly;
 
-            gfx_TransparentSprite(thwomp_0, rel_x, rel_y);
+            emit_sprite(thwomp_0, rel_x, rel_y);
 
             if (y == cur->start_y) {
                 if (oiram.x >= x - 20 && oiram.x <= x + 20 + OIRAM_HITBOX_WIDTH) {
@@ -127,7 +231,7 @@ void handle_pending_events(void) {
             if (oiram_collision(x, y, 23, 31)) {
                 if (!shrink_oiram()) {
                     add_poof(oiram.x, oiram.y + 2);
-                    remove_thwomp(i--);
+                    remove_thwomp(i);
                     continue;
                 }
             }
@@ -138,12 +242,16 @@ void handle_pending_events(void) {
     }
 
     if (num_simple_movers) {
-        for(i = 0; i < num_simple_movers; i++) {
+        for(i = next_active(GRID_SIMPLE_MOVERS, -1); i < num_simple_movers; i = next_active(GRID_SIMPLE_MOVERS, i)) {
             simple_move_t *cur = simple_mover[i];
             uint8_t type;
 
-            x = cur->x;
-            y = cur->y;
+            if (!cur) {
+                continue;
+            }
+
+            x = movers.x[cur->slot];
+            y = movers.y[cur->slot];
 
             if (!in_viewport(x, y)) {
                 continue;
@@ -159,14 +267,15 @@ void handle_pending_events(void) {
                    }
                }
 HANDLE_LOOP_FAIL:
-               remove_simple_mover(i--);
+               remove_simple_mover(i);
                continue;
             }
 
             simple_move_handler(cur);
+            grid_moved(GRID_SIMPLE_MOVERS, i);
 
-            x = cur->x;
-            y = cur->y;
+            x = movers.x[cur->slot];
+            y = movers.y[cur->slot];
 
             if (something_died) {
                 something_died = false;
@@ -178,7 +287,7 @@ HANDLE_LOOP_FAIL:
             rel_y = y - oiram.scrolly;
             type = cur->type;
 
-            if (cur->bumped) {
+            if (movers.bumped[cur->slot]) {
                 switch(type) {
                     case GOOMBA_TYPE:
                         add_poof(x + 4, y + 4);
@@ -191,12 +300,12 @@ HANDLE_LOOP_FAIL:
                         add_score(0, x, y);
                         goto HANDLE_CREATE_SHELL;
                     default:
-                        cur->bumped = false;
+                        movers.bumped[cur->slot] = false;
                         break;
                 }
             }
 
-            if (!oiram_collision(x, y, cur->hitbox.width, cur->hitbox.height)) {
+            if (!oiram_collision(x, y, movers.hitbox[cur->slot].width, movers.hitbox[cur->slot].height)) {
                 gfx_sprite_t *img;
                 gfx_rletsprite_t *rletimg;
                 static uint8_t reswob_sprite_count = 0;
@@ -220,7 +329,7 @@ HANDLE_DRAW_SPRITE:
                     case RESWOB_TYPE:
                         if (!reswob_is_jumping) {
                             if (!reswob_sprite_count) {
-                                if (cur->vx < 0) {
+                                if (movers.vx[cur->slot] < 0) {
                                     if (reswob_sprite == reswob_left_0) {
                                         rletimg = reswob_left_1;
                                     } else {
@@ -237,20 +346,20 @@ HANDLE_DRAW_SPRITE:
                             }
                             if (reswob_sprite_count++ == 5) { reswob_sprite_count = 0; }
                             if ((oiram.x >= x - 24 && oiram.x <= x + 40)) {
-                                cur->vy = -11;
+                                movers.vy[cur->slot] = -11;
                                 reswob_is_jumping = true;
                                 reswob_sprite = reswob_down;
                             }
                         } else {
-                            if (cur->vy == 0) {
+                            if (movers.vy[cur->slot] == 0) {
                                 reswob_force_fall = !reswob_force_fall;
                                 if (!reswob_force_fall) {
                                     reswob_is_jumping = false;
                                     if (oiram.x < x) {
-                                        cur->vx = -1;
+                                        movers.vx[cur->slot] = -1;
                                         rletimg = reswob_left_0;
                                     } else {
-                                        cur->vx = 1;
+                                        movers.vx[cur->slot] = 1;
                                         rletimg = reswob_right_0;
                                     }
                                     move_side = TILE_RESWOB_DOWN;
@@ -260,7 +369,7 @@ HANDLE_DRAW_SPRITE:
                             }
                         }
                         rletimg = reswob_sprite;
-                        gfx_RLETSprite(rletimg, rel_x, rel_y);
+                        emit_rlet_sprite(rletimg, rel_x, rel_y);
                         goto HANDLE_SKIP_DRAW;
                     case GOOMBA_TYPE:
 HANDLE_DRAW_SPRITE_GOOMBA:
@@ -271,7 +380,7 @@ HANDLE_DRAW_GOOMBA_FLAT:
                         img = goomba_flat;
                         break;
                     case KOOPA_BONES_TYPE:
-                        if (cur->vx < 0) {
+                        if (movers.vx[cur->slot] < 0) {
                             img = koopa_bones_left_sprite;
                         } else {
                             img = koopa_bones_right_sprite;
@@ -279,22 +388,22 @@ HANDLE_DRAW_GOOMBA_FLAT:
                         break;
                     case KOOPA_RED_FLY_TYPE:
                         if (x > oiram.x) {
-                            gfx_TransparentSprite(koopa_red_left_sprite, rel_x, rel_y);
-                            gfx_TransparentSprite(wing_left_sprite, rel_x + 7, rel_y);
+                            emit_sprite(koopa_red_left_sprite, rel_x, rel_y);
+                            emit_sprite(wing_left_sprite, rel_x + 7, rel_y);
                         } else {
-                            gfx_TransparentSprite(koopa_red_right_sprite, rel_x, rel_y);
-                            gfx_TransparentSprite(wing_right_sprite, rel_x, rel_y);
+                            emit_sprite(koopa_red_right_sprite, rel_x, rel_y);
+                            emit_sprite(wing_right_sprite, rel_x, rel_y);
                         }
                         goto HANDLE_SKIP_DRAW;
                     case KOOPA_RED_TYPE:
-                        if (cur->vx < 0) {
+                        if (movers.vx[cur->slot] < 0) {
                             img = koopa_red_left_sprite;
                         } else {
                             img = koopa_red_right_sprite;
                         }
                         break;
                     case SPIKE_TYPE:
-                        if (cur->vx < 0) {
+                        if (movers.vx[cur->slot] < 0) {
                             img = spike_left_sprite;
                         } else {
                             img = spike_right_sprite;
@@ -302,15 +411,15 @@ HANDLE_DRAW_GOOMBA_FLAT:
                         break;
                     case KOOPA_GREEN_FLY_TYPE:
                         if (x > oiram.x) {
-                            gfx_TransparentSprite(koopa_green_left_sprite, rel_x, rel_y);
-                            gfx_TransparentSprite(wing_left_sprite, rel_x + 7, rel_y);
+                            emit_sprite(koopa_green_left_sprite, rel_x, rel_y);
+                            emit_sprite(wing_left_sprite, rel_x + 7, rel_y);
                         } else {
-                            gfx_TransparentSprite(koopa_green_right_sprite, rel_x, rel_y);
-                            gfx_TransparentSprite(wing_right_sprite, rel_x, rel_y);
+                            emit_sprite(koopa_green_right_sprite, rel_x, rel_y);
+                            emit_sprite(wing_right_sprite, rel_x, rel_y);
                         }
                         goto HANDLE_SKIP_DRAW;
                     case KOOPA_GREEN_TYPE:
-                        if (cur->vx < 0) {
+                        if (movers.vx[cur->slot] < 0) {
                             img = koopa_green_left_sprite;
                         } else {
                             img = koopa_green_right_sprite;
@@ -330,18 +439,25 @@ HANDLE_DRAW_BONES_FLAT:
                     case SPIKE_SHELL_TYPE:
                         if (cur->sprite == spike_shell_1) { img = spike_shell_0; } else { img = spike_shell_1; }
 HANDLE_DRAW_SHELL:
-                        if (cur->vx) {
-                            uint8_t j;
+                        if (movers.vx[cur->slot]) {
+                            uint8_t found[GRID_MAX_FOUND];
+                            uint8_t j, k, num_found;
                             cur->sprite = img;
 
-                            for(j = 0; j < num_simple_movers; j++) {
-                                simple_move_t *hit = simple_mover[j];
-                                uint8_t hit_type = hit->type;
+                            num_found = query_grid(GRID_SIMPLE_MOVERS, x, x + 15, found);
+                            for(k = 0; k < num_found; k++) {
+                                simple_move_t *hit = simple_mover[j = found[k]];
+                                uint8_t hit_type;
+
+                                if (!hit) {
+                                    continue;
+                                }
 
+                                hit_type = hit->type;
                                 if (hit_type > HITABLE_TYPES) {
-                                    int hit_x = hit->x;
-                                    int hit_y = hit->y;
-                                    if (gfx_CheckRectangleHotspot(hit_x, hit_y, hit->hitbox.width, hit->hitbox.height, x, y, 15, 15)) {
+                                    int hit_x = movers.x[hit->slot];
+                                    int hit_y = movers.y[hit->slot];
+                                    if (gfx_CheckRectangleHotspot(hit_x, hit_y, movers.hitbox[hit->slot].width, movers.hitbox[hit->slot].height, x, y, 15, 15)) {
                                         if (i != j) {
                                             add_score(cur->score_counter, x, y);
                                             if(cur->score_counter != 8) { cur->score_counter++; }
@@ -354,15 +470,16 @@ HANDLE_DRAW_SHELL:
                                 }
                             }
 
-                            for(j = 0; j < num_chompers; j++) {
-                                chomper_t *hit = chomper[j];
+                            num_found = query_grid(GRID_CHOMPERS, x, x + 15, found);
+                            for(k = 0; k < num_found; k++) {
+                                chomper_t *hit = chomper[j = found[k]];
 
-                                if (hit->y < hit->start_y) {
+                                if (hit && hit->y < hit->start_y) {
                                     if (gfx_CheckRectangleHotspot(hit->x, hit->y, 15, 30, x, y, 15, 15)) {
-                                        remove_chomper(j);
                                         add_score(cur->score_counter, x, y);
                                         if(cur->score_counter != 8) { cur->score_counter++; }
                                         add_poof(hit->x + 4, y);
+                                        remove_chomper(j);
                                         break;
                                     }
                                 }
@@ -376,7 +493,7 @@ HANDLE_DRAW_SHELL:
                     default:
                         goto HANDLE_SKIP_DRAW;
                 }
-                gfx_TransparentSprite(img, rel_x, rel_y);
+                emit_sprite(img, rel_x, rel_y);
             } else {
                 switch(type) {
                     case RESWOB_TYPE:
@@ -396,9 +513,10 @@ HANDLE_DRAW_SHELL:
 HANDLE_REMOVE_MOVER:
                         add_score(4, x, y);
 HANDLE_REMOVE_MOVER_NO_SCORE:
+                        // restart the scan, cur has been freed
                         remove_simple_mover(i);
                         i = -1;
-                        break;
+                        continue;
                     case GOOMBA_TYPE:
                         if ((oiram.vy <= 0 && oiram.y + ((oiram.flags & FLAG_OIRAM_BIG) ? 11 : 0) >= y) ||
                             (oiram.flags & (FLAG_OIRAM_INVINCIBLE | FLAG_OIRAM_SLIDE))) {
@@ -412,9 +530,9 @@ HANDLE_REMOVE_MOVER_NO_SCORE:
                         } else {
                             add_next_chain_score(x, y);
                             oiram.vy = -5;
-                            cur->hitbox.height = 8;
+                            movers.hitbox[cur->slot].height = 8;
                             type = FLAT_GOOMBA_TYPE;
-                            cur->vx = 0;
+                            movers.vx[cur->slot] = 0;
                             y += 5;
                             cur->counter = 30;
                             goto HANDLE_DRAW_SPRITE_GOOMBA;
@@ -437,17 +555,17 @@ HANDLE_REMOVE_MOVER_NO_SCORE:
                             oiram.vy = -9;
                             if (type == KOOPA_GREEN_FLY_TYPE) {
                                 type = KOOPA_GREEN_TYPE;
-                                cur->smart = false;
+                                movers.smart[cur->slot] = false;
                             } else {
                                 type = KOOPA_RED_TYPE;
                             }
-                            cur->vy = 0;
+                            movers.vy[cur->slot] = 0;
                             if (rel_x < oiram.x) {
-                                cur->vx = 1;
+                                movers.vx[cur->slot] = 1;
                             } else {
-                                cur->vx = -1;
+                                movers.vx[cur->slot] = -1;
                             }
-                            cur->is_flyer = false;
+                            movers.is_flyer[cur->slot] = false;
                             goto HANDLE_DRAW_SPRITE;
                         }
                         break;
@@ -470,42 +588,42 @@ HANDLE_CREATE_SHELL:
                             if (type == KOOPA_RED_TYPE) {
                                 cur->sprite = koopa_red_shell_0;
                                 type = KOOPA_RED_SHELL_TYPE;
-                                cur->hitbox.height = 15;
+                                movers.hitbox[cur->slot].height = 15;
                             } else if (type == KOOPA_GREEN_TYPE) {
                                 cur->sprite = koopa_green_shell_0;
                                 type = KOOPA_GREEN_SHELL_TYPE;
-                                cur->hitbox.height = 15;
+                                movers.hitbox[cur->slot].height = 15;
                             } else if (type == SPIKE_TYPE) {
                                 cur->sprite = spike_shell_0;
                                 type = SPIKE_SHELL_TYPE;
                             } else {
-                                cur->sprite = (cur->vx < 0) ? koopa_bones_dead_left : koopa_bones_dead_right;
+                                cur->sprite = (movers.vx[cur->slot] < 0) ? koopa_bones_dead_left : koopa_bones_dead_right;
                                 type = KOOPA_BONES_DEAD_TYPE;
-                                cur->hitbox.height = 12;
-                                cur->vx = 0;
+                                movers.hitbox[cur->slot].height = 12;
+                                movers.vx[cur->slot] = 0;
                                 y += 11;
-                                cur->smart = false;
+                                movers.smart[cur->slot] = false;
                                 cur->counter = 127;
                                 goto HANDLE_DRAW_BONES_FLAT;
                             }
-                            cur->vx = 0;
+                            movers.vx[cur->slot] = 0;
                             y += 11;
-                            cur->smart = false;
+                            movers.smart[cur->slot] = false;
                             cur->counter = 127;
                             goto HANDLE_DRAW_SPRITE;
                         }
                         break;
                     case KOOPA_RED_SHELL_TYPE: case KOOPA_GREEN_SHELL_TYPE:
-                        if (cur->vy > 0 || oiram.y + oiram.hitbox.height - 8 < y) {
+                        if (movers.vy[cur->slot] > 0 || oiram.y + oiram.hitbox.height - 8 < y) {
                             oiram.vy = -8;
-                            if (!cur->vx && (oiram.x != x)) {
+                            if (!movers.vx[cur->slot] && (oiram.x != x)) {
                                 goto HANDLE_KICK_SHELL;
                             }
-                            cur->vx = 0;
+                            movers.vx[cur->slot] = 0;
                             cur->score_counter = 0;
                             cur->counter = 127;
                         } else {
-                            if (cur->vx) {
+                            if (movers.vx[cur->slot]) {
                     case SPIKE_SHELL_TYPE:
                                 if (oiram.vy <= 0 || oiram.flags & (FLAG_OIRAM_INVINCIBLE | FLAG_OIRAM_SLIDE)) {
                                     if (!shrink_oiram()) {
@@ -519,9 +637,9 @@ HANDLE_CREATE_SHELL:
                             } else {
 HANDLE_KICK_SHELL:
                                 if ((oiram.x + OIRAM_HITBOX_WIDTH/2) < x) {
-                                    cur->vx = 5;
+                                    movers.vx[cur->slot] = 5;
                                 } else {
-                                    cur->vx = -5;
+                                    movers.vx[cur->slot] = -5;
                                 }
                                 add_score(0, x, y);
                                 cur->counter = -1;
@@ -538,12 +656,12 @@ HANDLE_SKIP_DRAW:
             if (cur->counter >= 0) {
                 cur->counter--;
                 if (!cur->counter) {
-                    cur->smart = true;
-                    cur->hitbox.height = 26;
+                    movers.smart[cur->slot] = true;
+                    movers.hitbox[cur->slot].height = 26;
                     y -= 11;
 
                     if (type == KOOPA_GREEN_SHELL_TYPE) {
-                        cur->smart = false;
+                        movers.smart[cur->slot] = false;
                         type = KOOPA_GREEN_TYPE;
                     } else if (type == KOOPA_RED_SHELL_TYPE) {
                         type = KOOPA_RED_TYPE;
@@ -553,29 +671,35 @@ HANDLE_SKIP_DRAW:
                     } else if (type == SPIKE_SHELL_TYPE) {
                         type = SPIKE_TYPE;
                         y += 10;
-                        cur->hitbox.height = 15;
-                        cur->smart = false;
+                        movers.hitbox[cur->slot].height = 15;
+                        movers.smart[cur->slot] = false;
                     } else {
                         goto HANDLE_REMOVE_MOVER_NO_SCORE;
                     }
                     cur->counter = -1;
                     if (oiram.x < rel_x) {
-                        cur->vx = -1;
+                        movers.vx[cur->slot] = -1;
                     } else {
-                        cur->vx = 1;
+                        movers.vx[cur->slot] = 1;
                     }
                 }
             }
-            cur->y = y;
+            movers.y[cur->slot] = y;
             cur->type = type;
             continue;
         }
     }
 
     if (num_bumped_tiles) {
-        for(i = 0; i < num_bumped_tiles; i++) {
+        for(i = next_active(GRID_BUMPED_TILES, -1); i < num_bumped_tiles; i = next_active(GRID_BUMPED_TILES, i)) {
             bumped_tile_t *cur = bumped_tile[i];
-            uint8_t tile_img = cur->tile;
+            uint8_t tile_img;
+
+            if (!cur) {
+                continue;
+            }
+
+            tile_img = cur->tile;
 
             x = cur->x;
             y = cur->y;
@@ -614,10 +738,10 @@ HANDLE_SKIP_DRAW:
 HANDLE_SKIP_BUMP:
 
             // draw the tile
-            gfx_TransparentSprite(tileset_tiles[tile_img], x - oiram.scrollx, y - oiram.scrolly);
+            emit_sprite(tileset_tiles[tile_img], x - oiram.scrollx, y - oiram.scrolly);
 
             if (!cur->count) {
-                remove_bumped_tile(i--);
+                remove_bumped_tile(i);
             }
         }
     }
@@ -625,10 +749,14 @@ HANDLE_SKIP_BUMP:
     if (num_chompers && !easter_egg4) {
         uint8_t dir = 0;
 
-        for(i = 0; i < num_chompers; i++) {
+        for(i = next_active(GRID_CHOMPERS, -1); i < num_chompers; i = next_active(GRID_CHOMPERS, i)) {
             chomper_t *cur = chomper[i];
             int start_y;
 
+            if (!cur) {
+                continue;
+            }
+
             x = cur->x;
             y = cur->y;
 
@@ -644,7 +772,7 @@ HANDLE_SKIP_BUMP:
                 int ymax = start_y - oiram.scrolly;
                 if (ymax <= 0) { goto HANDLE_CHOMER_NO_DRAW; }
                 if (ymax > Y_PXL_MAX) { ymax = Y_PXL_MAX; }
-                gfx_SetClipRegion(0, 0, X_PXL_MAX, ymax);
+                emit_clip(0, 0, X_PXL_MAX, ymax);
 
                 if (cur->throws_fire) {
                     gfx_sprite_t *img;
@@ -665,11 +793,11 @@ HANDLE_SKIP_BUMP:
                             dir = UP_RIGHT;
                         }
                     }
-                    gfx_TransparentSprite(img, rel_x, rel_y);
+                    emit_sprite(img, rel_x, rel_y);
                 } else {
-                    gfx_TransparentSprite(chomper_sprite, rel_x, rel_y);
+                    emit_sprite(chomper_sprite, rel_x, rel_y);
                 }
-                gfx_TransparentSprite(chomper_body, rel_x, rel_y + 16);
+                emit_sprite(chomper_body, rel_x, rel_y + 16);
             }
 HANDLE_CHOMER_NO_DRAW:
             if (!cur->count) {
@@ -692,23 +820,27 @@ HANDLE_CHOMER_NO_DRAW:
                 if (!warp.style && !shrink_oiram()) {
                     add_score(1, x, y);
                     add_poof(oiram.x, oiram.y + 2);
-                    remove_chomper(i--);
+                    remove_chomper(i);
                     continue;
                 }
             }
 
             cur->y = y;
         }
-        gfx_SetClipRegion(0, 0, X_PXL_MAX, Y_PXL_MAX);
+        emit_clip(0, 0, X_PXL_MAX, Y_PXL_MAX);
     }
 
     if (num_simple_enemies) {
-        for(i = 0; i < num_simple_enemies; i++) {
+        for(i = next_active(GRID_SIMPLE_ENEMIES, -1); i < num_simple_enemies; i = next_active(GRID_SIMPLE_ENEMIES, i)) {
             enemy_t *cur = simple_enemy[i];
             gfx_sprite_t *img;
             uint8_t *tile;
             int tmp_add;
 
+            if (!cur) {
+                continue;
+            }
+
             x = cur->x;
             y = cur->y;
 
@@ -721,10 +853,10 @@ HANDLE_CHOMER_NO_DRAW:
                 case SCORE_TYPE:
                     cur->counter--;
                     if (!cur->counter) {
-                        remove_simple_enemy(i--);
+                        remove_simple_enemy(i);
                     } else {
                         cur->y--;
-                        gfx_TransparentSprite(cur->sprite, rel_x, rel_y);
+                        emit_sprite(cur->sprite, rel_x, rel_y);
                     }
                     break;
                 case FISH_TYPE:
@@ -738,17 +870,19 @@ HANDLE_CHOMER_NO_DRAW:
                         img = fish_right_sprite;
                         tmp_add = 16;
                     }
-                    gfx_TransparentSprite(img, rel_x, rel_y);
+                    emit_sprite(img, rel_x, rel_y);
                     if (!moveable_tile(x + cur->vx + tmp_add, y)) {
                         cur->vx = -cur->vx;
                     }
                     cur->x += cur->vx;
+                    grid_moved(GRID_SIMPLE_ENEMIES, i);
                     if (oiram_collision(x, y, 16, 16)) {
                         if (!shrink_oiram()) {
                             add_score_no_sprite(1);
                             cur->type = SCORE_TYPE;
                             cur->counter = 16;
                             cur->sprite = score_200;
+                            invalidate_grid(GRID_SIMPLE_ENEMIES);
                         }
                     }
                     break;
@@ -795,11 +929,11 @@ HANDLE_CHOMER_NO_DRAW:
                 case CANNONBALL_TYPE:
                 case BULLET_TYPE:
                     if (!in_viewport(x, y)) {
-                        remove_simple_enemy(i--);
+                        remove_simple_enemy(i);
                         continue;
                     }
 
-                    gfx_TransparentSprite(cur->sprite, rel_x, rel_y);
+                    emit_sprite(cur->sprite, rel_x, rel_y);
                     cur->x += cur->vx;
                     cur->y += cur->vy;
                     if (oiram_collision(x, y, 15, 13)) {
@@ -817,7 +951,7 @@ HANDLE_CHOMER_NO_DRAW:
                     break;
                 case LEAF_TYPE:
                     if (y > level_map.max_y) {
-                        remove_simple_enemy(i--);
+                        remove_simple_enemy(i);
                         continue;
                     }
 
@@ -827,7 +961,7 @@ HANDLE_CHOMER_NO_DRAW:
                         img = leaf_right;
                     }
 
-                    gfx_TransparentSprite(img, rel_x, rel_y);
+                    emit_sprite(img, rel_x, rel_y);
                     cur->x += cur->vx;
                     cur->y++;
 
@@ -854,10 +988,16 @@ HANDLE_CHOMER_NO_DRAW:
     start_boo_check:
 
     if (num_boos) {
-        for(i = 0; i < num_boos; i++) {
+        for(i = next_active(GRID_BOOS, -1); i < num_boos; i = next_active(GRID_BOOS, i)) {
             boo_t *cur = boo[i];
             gfx_sprite_t *img;
-            int prev_x = x = cur->x;
+            int prev_x;
+
+            if (!cur) {
+                continue;
+            }
+
+            prev_x = x = cur->x;
             y = cur->y;
 
             if (!in_viewport(x, y)) {
@@ -904,28 +1044,33 @@ HANDLE_CHOMER_NO_DRAW:
             }
 
 
-            gfx_TransparentSprite(img, rel_x, rel_y);
+            emit_sprite(img, rel_x, rel_y);
 
             if (oiram_collision(x, y, 15, 15)) {
                 if (!shrink_oiram()) {
                     add_score(1, x, y);
                     add_poof(oiram.x, oiram.y + 2);
-                    remove_boo(i--);
+                    remove_boo(i);
                     continue;
                 }
             }
 
             cur->x = x;
             cur->y = y;
+            grid_moved(GRID_BOOS, i);
         }
     }
 
     if (num_flames) {
 
-        for(i = 0; i < num_flames; i++) {
+        for(i = next_active(GRID_FLAMES, -1); i < num_flames; i = next_active(GRID_FLAMES, i)) {
             int8_t tmp_vy;
             flame_t *cur = flame[i];
 
+            if (!cur) {
+                continue;
+            }
+
             x = cur->x;
             y = cur->y;
 
@@ -938,7 +1083,7 @@ HANDLE_CHOMER_NO_DRAW:
             if (y < cur->start_y) {
                 gfx_sprite_t *img;
                 if (tmp_vy < 0) { img = flame_sprite_up; } else { img = flame_sprite_down; }
-                gfx_TransparentSprite(img, x - oiram.scrollx, y - oiram.scrolly);
+                emit_sprite(img, x - oiram.scrollx, y - oiram.scrolly);
             }
 
             if (cur->count) {
@@ -957,7 +1102,7 @@ HANDLE_CHOMER_NO_DRAW:
                 if (!shrink_oiram()) {
                     add_score(1, x, y);
                     add_poof(oiram.x, oiram.y + 2);
-                    remove_flame(i--);
+                    remove_flame(i);
                     continue;
                 }
             }
@@ -971,10 +1116,14 @@ HANDLE_CHOMER_NO_DRAW:
         for(i = 0; i < num_poofs; i++) {
             poof_t *cur = poof[i];
 
+            if (!cur) {
+                continue;
+            }
+
             cur->count--;
             if (!cur->count) {
                 if (cur->second) {
-                    remove_poof(i--);
+                    remove_poof(i);
                     continue;
                 } else {
                     cur->second = true;
@@ -982,7 +1131,7 @@ HANDLE_CHOMER_NO_DRAW:
                 }
             }
 
-            gfx_TransparentSprite((cur->second) ? poof_1 : poof_0, cur->x - oiram.scrollx, cur->y - oiram.scrolly);
+            emit_sprite((cur->second) ? poof_1 : poof_0, cur->x - oiram.scrollx, cur->y - oiram.scrolly);
         }
     }
 
@@ -992,8 +1141,14 @@ HANDLE_CHOMER_NO_DRAW:
 
         for(i = 0; i < num_fireballs; i++) {
             fireball_t *cur = fireball[i];
-            uint8_t cur_type = cur->mover->type;
-            tmp_vx = cur->mover->vx;
+            uint8_t cur_type;
+
+            if (!cur) {
+                continue;
+            }
+
+            cur_type = cur->mover->type;
+            tmp_vx = movers.vx[cur->mover->slot];
 
             if (cur_type == OIRAM_FIREBALL) {
                 cur->mover->type = FIREBALL_TYPE;
@@ -1001,45 +1156,50 @@ HANDLE_CHOMER_NO_DRAW:
                 cur->mover->type = cur_type;
                 if (something_died) {
                     something_died = false;
-                    add_poof(cur->mover->x + 4, cur->mover->y + 4);
+                    add_poof(movers.x[cur->mover->slot] + 4, movers.y[cur->mover->slot] + 4);
                     goto HANDLE_REMOVE_FIREBALL;
                 }
             } else {
-                cur->mover->x += tmp_vx;
-                cur->mover->y += cur->mover->vy;
+                movers.x[cur->mover->slot] += tmp_vx;
+                movers.y[cur->mover->slot] += movers.vy[cur->mover->slot];
             }
 
-            x = cur->mover->x;
-            y = cur->mover->y;
+            x = movers.x[cur->mover->slot];
+            y = movers.y[cur->mover->slot];
 
             rel_x = x - oiram.scrollx;
             rel_y = y - oiram.scrolly;
 
-            if (tmp_vx != cur->mover->vx || !cur->count-- || rel_x < -20 || rel_x > 350) {
+            if (tmp_vx != movers.vx[cur->mover->slot] || !cur->count-- || rel_x < -20 || rel_x > 350) {
                 add_poof(x + 2, y + 2);
 HANDLE_REMOVE_FIREBALL:
-                remove_fireball(i--);
+                remove_fireball(i);
                 continue;
             }
 
             if (cur_type == OIRAM_FIREBALL) {
-                for(j = 0; j < num_simple_movers; j++) {
-                    simple_move_t *hit = simple_mover[j];
+                uint8_t found[GRID_MAX_FOUND];
+                uint8_t k, num_found;
+
+                num_found = query_grid(GRID_SIMPLE_MOVERS, x, x + 7, found);
+                for(k = 0; k < num_found; k++) {
+                    simple_move_t *hit = simple_mover[j = found[k]];
 
-                    if (hit->type > HITABLE_TYPES) {
-                        if (gfx_CheckRectangleHotspot(hit->x, hit->y, hit->hitbox.width, hit->hitbox.height, x, y, 7, 7)) {
+                    if (hit && hit->type > HITABLE_TYPES) {
+                        if (gfx_CheckRectangleHotspot(movers.x[hit->slot], movers.y[hit->slot], movers.hitbox[hit->slot].width, movers.hitbox[hit->slot].height, x, y, 7, 7)) {
                             add_score(1, x,y );
-                            add_poof(hit->x + 4, hit->y + 4);
+                            add_poof(movers.x[hit->slot] + 4, movers.y[hit->slot] + 4);
                             remove_simple_mover(j);
                             goto HANDLE_REMOVE_FIREBALL;
                         }
                     }
                 }
 
-                for(j = 0; j < num_chompers; j++) {
-                    chomper_t *hit = chomper[j];
+                num_found = query_grid(GRID_CHOMPERS, x, x + 7, found);
+                for(k = 0; k < num_found; k++) {
+                    chomper_t *hit = chomper[j = found[k]];
 
-                    if (gfx_CheckRectangleHotspot(hit->x, hit->y, 15, 29, x, y, 7, 7)) {
+                    if (hit && gfx_CheckRectangleHotspot(hit->x, hit->y, 15, 29, x, y, 7, 7)) {
                         add_score(1, x, y);
                         add_poof(hit->x + 4, y);
                         remove_chomper(j);
@@ -1055,39 +1215,39 @@ HANDLE_REMOVE_FIREBALL:
                     goto HANDLE_REMOVE_FIREBALL;
                 }
             }
-            gfx_TransparentSprite(fireball_sprite, rel_x, rel_y);
+            emit_sprite(fireball_sprite, rel_x, rel_y);
         }
     }
 
     // draw the oiram sprite
     if (oiram.failed && oiram.started_fail) {
-        gfx_TransparentSprite(oiram_fail, oiram.fail_x - oiram.scrollx, oiram.fail_y - oiram.scrolly);
+        emit_sprite(oiram_fail, oiram.fail_x - oiram.scrollx, oiram.fail_y - oiram.scrolly);
     } else if (in_quicksand) {
-        gfx_SetClipRegion(0, 0, X_PXL_MAX, quicksand_clip_y - oiram.scrolly);
+        emit_clip(0, 0, X_PXL_MAX, quicksand_clip_y - oiram.scrolly);
         goto HANDLE_DRAW_OIRAM;
     } else if (warp.style) {
         if (!warp.enter) {
             switch (warp.style) {
                 case PIPE_DOWN:
                 HANDLE_PIPE_DOWN:
-                    gfx_SetClipRegion(0, warp.clip_y - oiram.scrolly, X_PXL_MAX, Y_PXL_MAX);
+                    emit_clip(0, warp.clip_y - oiram.scrolly, X_PXL_MAX, Y_PXL_MAX);
                     break;
                 case PIPE_LEFT:
                 HANDLE_PIPE_LEFT:
-                    gfx_SetClipRegion(warp.clip_x - oiram.scrollx, 0, X_PXL_MAX, Y_PXL_MAX);
+                    emit_clip(warp.clip_x - oiram.scrollx, 0, X_PXL_MAX, Y_PXL_MAX);
                     break;
                 case PIPE_RIGHT:
                 HANDLE_PIPE_RIGHT:
-                    gfx_SetClipRegion(0, 0, warp.clip_x - oiram.scrollx, Y_PXL_MAX);
+                    emit_clip(0, 0, warp.clip_x - oiram.scrollx, Y_PXL_MAX);
                     break;
                 case PIPE_UP:
                 HANDLE_PIPE_UP:
-                    gfx_SetClipRegion(0, 0, X_PXL_MAX, warp.clip_y - oiram.scrolly);
+                    emit_clip(0, 0, X_PXL_MAX, warp.clip_y - oiram.scrolly);
                     break;
                 case DOOR_WARP:
                 HANDLE_DOOR_WARP:
-                    gfx_Sprite(door_top, oiram.door_x - oiram.scrollx, oiram.door_y - oiram.scrolly);
-                    gfx_Sprite(door_bot, oiram.door_x - oiram.scrollx, oiram.door_y + 16 - oiram.scrolly);
+                    emit_opaque_sprite(door_top, oiram.door_x - oiram.scrollx, oiram.door_y - oiram.scrolly);
+                    emit_opaque_sprite(door_bot, oiram.door_x - oiram.scrollx, oiram.door_y + 16 - oiram.scrolly);
                     break;
             }
         } else {
@@ -1119,7 +1279,7 @@ HANDLE_REMOVE_FIREBALL:
         }
     } else {
 HANDLE_DRAW_OIRAM:
-        gfx_TransparentSprite(oiram.sprite, oiram.rel_x, oiram.rel_y);
+        emit_sprite(oiram.sprite, oiram.rel_x, oiram.rel_y);
     }
 
     if (oiram.has_shell) {
@@ -1140,7 +1300,7 @@ HANDLE_DRAW_OIRAM:
         } else {
             shell_y = oiram.rel_y;
         }
-        gfx_TransparentSprite(shell, shell_x, shell_y);
+        emit_sprite(shell, shell_x, shell_y);
     }
 
     if ((oiram.flags & FLAG_OIRAM_RACOON) && !oiram.on_vine) {
@@ -1172,11 +1332,19 @@ HANDLE_DRAW_OIRAM:
             }
         } else {
     draw_tail:
-            gfx_TransparentSprite(tail_img, tail_x, tail_y);
+            emit_sprite(tail_img, tail_x, tail_y);
         }
     }
 
-    gfx_SetClipRegion(0, 0, X_PXL_MAX, Y_PXL_MAX);
+    emit_clip(0, 0, X_PXL_MAX, Y_PXL_MAX);
+
+    // compact the tables the removals above left holes in
+    sweep_entity_tables();
 
     handling_events = false;
 }
+
+void draw_pending_events(void) {
+    draw_event_list();
+    num_event_draws = 0;
+}
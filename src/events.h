@@ -5,7 +5,15 @@
 
 extern bool handling_events;
 
-void handle_pending_events(void);
+// moves, collides and scores everything that isn't oiram. when the frame is drawn it leaves the
+// sprites to draw for draw_pending_events, drawing them early if there are more than it keeps
+void update_pending_events(bool draw);
+
+// draws the sprites the last update left, in order. skipping it leaves the simulation unchanged
+void draw_pending_events(void);
 bool in_viewport(int x, int y);
 
+// the x the in_viewport window is around, oiram or where oiram failed
+int viewport_x(void);
+
 #endif
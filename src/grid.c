@@ -0,0 +1,299 @@
+#include "platform.h"
+#include "debug.h"
+
+#include <stdbool.h>
+
+#if !TARGET_PRIZM
+#include <stdint.h>
+#endif
+
+#include "grid.h"
+#include "defines.h"
+#include "enemies.h"
+#include "events.h"
+#include "simple_mover.h"
+#include "tile_handlers.h"
+
+// entries are filed under up to 3 bands each, more than a hitbox plus margins can cover
+#define GRID_MAX_ENTRIES (GRID_MAX_FOUND * 3)
+
+// entries that are filed under every band, in a list after the last band
+#define GRID_EVERYWHERE GRID_MAX_BANDS
+
+// filed widths of tombstones and of entries that are filed everywhere
+#define FILED_NONE       255
+#define FILED_EVERYWHERE 254
+
+typedef struct {
+    bool valid;
+    uint8_t count;                          // table size when built, entries after it are always returned
+    uint8_t active_count;                   // the same for the current next_active walk
+    int16_t x[GRID_MAX_FOUND];              // where each entry was filed
+    uint8_t width[GRID_MAX_FOUND];
+    uint16_t band_start[GRID_MAX_BANDS + 2];
+    uint8_t entries[GRID_MAX_ENTRIES];
+    uint32_t active[GRID_MAX_FOUND / 32];   // entries in the window of the current next_active walk
+    int active_x;                           // and where the window was
+    bool active_valid;                      // false when the indices moved under the walk
+} grid_t;
+
+static grid_t grids[NUM_GRIDS];
+
+// bands are 1 << band_shift pixels wide, and the last one is band_last
+static uint8_t band_shift;
+static uint8_t band_last;
+
+static uint8_t table_size(uint8_t table) {
+    switch (table) {
+        case GRID_SIMPLE_MOVERS:  return num_simple_movers;
+        case GRID_SIMPLE_ENEMIES: return num_simple_enemies;
+        case GRID_CHOMPERS:       return num_chompers;
+        case GRID_THWOMPS:        return num_thwomps;
+        case GRID_FLAMES:         return num_flames;
+        case GRID_BOOS:           return num_boos;
+        default:                  return num_bumped_tiles;
+    }
+}
+
+// the x and hitbox width entry i is filed with
+static uint8_t file_entry(uint8_t table, uint8_t i, int *x) {
+    switch (table) {
+        case GRID_SIMPLE_MOVERS: {
+            simple_move_t *e = simple_mover[i];
+            if (!e) { return FILED_NONE; }
+            *x = movers.x[e->slot];
+            return movers.hitbox[e->slot].width;
+        }
+        case GRID_SIMPLE_ENEMIES: {
+            enemy_t *e = simple_enemy[i];
+            if (!e) { return FILED_NONE; }
+            *x = e->x;
+            switch (e->type) {
+                // these are handled wherever they are
+                case SCORE_TYPE:
+                case LEAF_TYPE:
+                case BULLET_TYPE:
+                case CANNONBALL_TYPE:
+                    return FILED_EVERYWHERE;
+                default:
+                    return 16;
+            }
+        }
+        case GRID_CHOMPERS: {
+            chomper_t *e = chomper[i];
+            if (!e) { return FILED_NONE; }
+            *x = e->x;
+            return 15;
+        }
+        case GRID_THWOMPS: {
+            thwomp_t *e = thwomp[i];
+            if (!e) { return FILED_NONE; }
+            *x = e->x;
+            return 23;
+        }
+        case GRID_FLAMES: {
+            flame_t *e = flame[i];
+            if (!e) { return FILED_NONE; }
+            *x = e->x;
+            return 14;
+        }
+        case GRID_BOOS: {
+            boo_t *e = boo[i];
+            if (!e) { return FILED_NONE; }
+            *x = e->x;
+            return 15;
+        }
+        default: {
+            bumped_tile_t *e = bumped_tile[i];
+            if (!e) { return FILED_NONE; }
+            *x = e->x;
+            return 15;
+        }
+    }
+}
+
+// entries off either end of the level are filed with the band at that end
+static uint8_t band_of(int x) {
+    if (x < 0) {
+        return 0;
+    }
+    x >>= band_shift;
+    return x < band_last ? x : band_last;
+}
+
+static void entry_bands(grid_t *grid, uint8_t i, uint8_t *first, uint8_t *last) {
+    if (grid->width[i] == FILED_EVERYWHERE) {
+        *first = *last = GRID_EVERYWHERE;
+    } else {
+        *first = band_of(grid->x[i] - GRID_MARGIN);
+        *last = band_of(grid->x[i] + grid->width[i] + GRID_MARGIN);
+    }
+}
+
+// files every entry of the table, counting the entries per band first so each band's list is
+// contiguous and in table order
+static void build_grid(uint8_t table) {
+    grid_t *grid = &grids[table];
+    uint8_t count = table_size(table);
+    uint16_t fill[GRID_MAX_BANDS + 1];
+    uint8_t i, band, first, last;
+    int x = 0;
+
+    memset(grid->band_start, 0, sizeof(grid->band_start));
+    for (i = 0; i < count; i++) {
+        grid->width[i] = file_entry(table, i, &x);
+        grid->x[i] = (int16_t)x;
+        if (grid->width[i] != FILED_NONE) {
+            entry_bands(grid, i, &first, &last);
+            for (band = first; band <= last; band++) {
+                grid->band_start[band + 1]++;
+            }
+        }
+    }
+    for (band = 0; band <= GRID_EVERYWHERE; band++) {
+        grid->band_start[band + 1] += grid->band_start[band];
+        fill[band] = grid->band_start[band];
+    }
+    for (i = 0; i < count; i++) {
+        if (grid->width[i] != FILED_NONE) {
+            entry_bands(grid, i, &first, &last);
+            for (band = first; band <= last; band++) {
+                grid->entries[fill[band]++] = i;
+            }
+        }
+    }
+
+    grid->count = count;
+    grid->valid = true;
+}
+
+static void mark_band(grid_t *grid, uint8_t band, uint32_t *marks) {
+    unsigned int i, end = grid->band_start[band + 1];
+    for (i = grid->band_start[band]; i < end; i++) {
+        marks[grid->entries[i] / 32] |= 1u << (grid->entries[i] % 32);
+    }
+}
+
+// an entry can be under two of the bands, so they are marked and read back in order
+static void mark_span(uint8_t table, int x1, int x2, uint32_t *marks) {
+    grid_t *grid = &grids[table];
+    uint8_t band, last = band_of(x2);
+
+    if (!grid->valid) {
+        build_grid(table);
+    }
+    memset(marks, 0, GRID_MAX_FOUND / 8);
+    for (band = band_of(x1); band <= last; band++) {
+        mark_band(grid, band, marks);
+    }
+    mark_band(grid, GRID_EVERYWHERE, marks);
+}
+
+void setup_grids(void) {
+    unsigned int level_width = tilemap.width * TILE_WIDTH;
+    unsigned int last_x = level_width ? level_width - 1 : 0;
+
+    band_shift = 0;
+    while ((1u << band_shift) < GRID_MIN_BAND_WIDTH || (last_x >> band_shift) >= GRID_MAX_BANDS) {
+        band_shift++;
+    }
+    band_last = last_x >> band_shift;
+    invalidate_grids();
+}
+
+uint8_t query_grid(uint8_t table, int x1, int x2, uint8_t *found) {
+    grid_t *grid = &grids[table];
+    uint32_t marks[GRID_MAX_FOUND / 32];
+    uint8_t count = table_size(table);
+    unsigned int i;
+    uint8_t num_found = 0;
+
+    mark_span(table, x1, x2, marks);
+    for (i = grid->count; i < count; i++) {
+        marks[i / 32] |= 1u << (i % 32);
+    }
+
+    for (i = 0; i < GRID_MAX_FOUND / 32; i++) {
+        uint32_t bits = marks[i];
+        unsigned int j = i * 32;
+        for (; bits; bits >>= 1, j++) {
+            if ((bits & 1) && j < count) {
+                found[num_found++] = j;
+            }
+        }
+    }
+    return num_found;
+}
+
+uint8_t next_active(uint8_t table, uint8_t i) {
+    grid_t *grid = &grids[table];
+    uint8_t count = table_size(table);
+    unsigned int j = i + 1;
+
+    // the same window as in_viewport, which moves when oiram fails during the walk
+    int t_x = viewport_x();
+
+    if (i == (uint8_t)-1) {
+        j = 0;
+    }
+    if (!j || t_x != grid->active_x || !grid->active_valid) {
+        mark_span(table, t_x - 359, t_x + 359, grid->active);
+        grid->active_count = grid->count;
+        grid->active_x = t_x;
+        grid->active_valid = true;
+    }
+
+    for (; j < count; j++) {
+        uint32_t bits;
+        if (j >= grid->active_count) {
+            break;
+        }
+        bits = grid->active[j / 32] >> (j % 32);
+        if (bits & 1) {
+            break;
+        }
+        if (!bits) {
+            j |= 31;
+        }
+    }
+    return j < count ? j : count;
+}
+
+// entries from the slot on are returned until the next build
+void grid_added(uint8_t table, uint8_t i) {
+    grid_t *grid = &grids[table];
+    if (i < grid->count) {
+        grid->count = i;
+    }
+    if (i < grid->active_count) {
+        grid->active_count = i;
+    }
+}
+
+void grid_moved(uint8_t table, uint8_t i) {
+    grid_t *grid = &grids[table];
+    int x, dx;
+
+    if (!grid->valid || i >= grid->count || grid->width[i] >= FILED_EVERYWHERE) {
+        return;
+    }
+    file_entry(table, i, &x);
+    dx = x - grid->x[i];
+    if (dx > GRID_MARGIN || dx < -GRID_MARGIN) {
+        grid->valid = false;
+    }
+}
+
+void invalidate_grid(uint8_t table) {
+    grids[table].valid = false;
+}
+
+// the indices moved, so a walk in progress marks its window again with the new ones and goes on
+// from where it is
+void invalidate_grids(void) {
+    uint8_t table;
+    for (table = 0; table < NUM_GRIDS; table++) {
+        grids[table].valid = false;
+        grids[table].active_valid = false;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef GRID_H
+#define GRID_H
+
+#if !TARGET_PRIZM
+#include <stdint.h>
+#endif
+
+#include "defines.h"
+
+// broadphase over the entity tables. each table entry is filed under the bands of level columns
+// its hitbox covers, and a query returns the entries filed under the bands an x span covers, in
+// table order. callers run the same checks in the same order as a scan of the whole table would,
+// only on the entries that can pass them. the bands are spread over the width of the level, and
+// are never narrower than this
+#define GRID_MIN_BAND_WIDTH (4*TILE_WIDTH)
+#define GRID_MAX_BANDS      64
+
+// how far an entry can move from where it was filed before the grid has to be rebuilt
+#define GRID_MARGIN     TILE_WIDTH
+
+// a query can return every entry of the table
+#define GRID_MAX_FOUND  256
+
+enum grid_tables {
+    GRID_SIMPLE_MOVERS=0,
+    GRID_SIMPLE_ENEMIES,
+    GRID_CHOMPERS,
+    GRID_THWOMPS,
+    GRID_FLAMES,
+    GRID_BOOS,
+    GRID_BUMPED_TILES,
+    NUM_GRIDS
+};
+
+// the level was loaded, works out the band width for its width
+void setup_grids(void);
+
+// entries of a table whose hitbox can overlap the span x1 to x2
+uint8_t query_grid(uint8_t table, int x1, int x2, uint8_t *found);
+
+// walks the entries of a table that are within the in_viewport window around oiram, in table
+// order: the index of the next one after i, or at least the table size when there are no more.
+// an i of -1 looks the window up again and starts over
+uint8_t next_active(uint8_t table, uint8_t i);
+
+// entry i was added, the slot may have been filed under another entry
+void grid_added(uint8_t table, uint8_t i);
+
+// entry i has moved
+void grid_moved(uint8_t table, uint8_t i);
+
+// the table changed in a way the filing can't follow, it is rebuilt on the next query
+void invalidate_grid(uint8_t table);
+
+// the tables were compacted or emptied
+void invalidate_grids(void);
+
+#endif
@@ -0,0 +1,221 @@
+#include "platform.h"
+#include "debug.h"
+#include "graphx.h"
+
+#include <time.h>
+
+// Per level frame phase timing for the host benchmark (oiram -b <frames>). The game loop marks the
+// end of each phase with Host_BenchPhase, the time since the previous mark is charged to that
+// phase, and a frame's total is the sum of its phases. Everything is reported at exit.
+//
+// Also the fill microbenchmark (oiram -m), comparing the graphx fills against the per pixel loops
+// they replaced.
+
+#define HOST_BENCH_MAX_LEVELS 256
+
+struct HostBenchLevel {
+	int level;
+	unsigned int numFrames;
+	unsigned int maxFrames;
+	unsigned int* samples;		// numFrames * HOST_BENCH_PHASES ns
+};
+
+static struct {
+	bool enabled;
+	HostBenchLevel levels[HOST_BENCH_MAX_LEVELS];
+	int numLevels;
+
+	// current frame
+	bool inFrame;
+	unsigned int phases[HOST_BENCH_PHASES];
+	unsigned long long last;
+} Bench;
+
+static const char* PhaseNames[HOST_BENCH_PHASES] = {
+	"move_oiram", "gfx_Tilemap", "events", "sprites", "animate", "blit", "other"
+};
+
+static unsigned long long GetNanos() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void CommitFrame() {
+	if (!Bench.inFrame || !Bench.numLevels) {
+		return;
+	}
+	Bench.inFrame = false;
+
+	HostBenchLevel& level = Bench.levels[Bench.numLevels - 1];
+	if (level.numFrames == level.maxFrames) {
+		level.maxFrames = level.maxFrames ? level.maxFrames * 2 : 256;
+		level.samples = (unsigned int*) realloc(level.samples, level.maxFrames * HOST_BENCH_PHASES * sizeof(unsigned int));
+	}
+	memcpy(&level.samples[level.numFrames * HOST_BENCH_PHASES], Bench.phases, sizeof(Bench.phases));
+	level.numFrames++;
+}
+
+static int CompareSamples(const void* a, const void* b) {
+	unsigned int x = *(const unsigned int*)a;
+	unsigned int y = *(const unsigned int*)b;
+	return x < y ? -1 : x > y;
+}
+
+static void PrintRow(const char* name, unsigned int* values, unsigned int count) {
+	qsort(values, count, sizeof(unsigned int), CompareSamples);
+	unsigned int p99 = (count * 99 + 99) / 100 - 1;
+	fprintf(stdout, "  %-12s %9.1f %9.1f %9.1f\n", name, values[0] / 1000.0, values[count / 2] / 1000.0, values[p99] / 1000.0);
+}
+
+void Host_BenchBegin(void) {
+	Bench.enabled = true;
+}
+
+void Host_BenchReport(void) {
+	if (!Bench.enabled) {
+		return;
+	}
+	CommitFrame();
+
+	for (int i = 0; i < Bench.numLevels; i++) {
+		HostBenchLevel& level = Bench.levels[i];
+		if (!level.numFrames) {
+			continue;
+		}
+
+		fprintf(stdout, "level %d: %u frames\n", level.level + 1, level.numFrames);
+		fprintf(stdout, "  %-12s %9s %9s %9s\n", "us", "min", "median", "p99");
+
+		unsigned int* values = (unsigned int*) malloc(level.numFrames * sizeof(unsigned int));
+		for (int phase = 0; phase < HOST_BENCH_PHASES; phase++) {
+			for (unsigned int frame = 0; frame < level.numFrames; frame++) {
+				values[frame] = level.samples[frame * HOST_BENCH_PHASES + phase];
+			}
+			PrintRow(PhaseNames[phase], values, level.numFrames);
+		}
+		for (unsigned int frame = 0; frame < level.numFrames; frame++) {
+			values[frame] = 0;
+			for (int phase = 0; phase < HOST_BENCH_PHASES; phase++) {
+				values[frame] += level.samples[frame * HOST_BENCH_PHASES + phase];
+			}
+		}
+		PrintRow("frame", values, level.numFrames);
+		free(values);
+	}
+}
+
+void Host_BenchFrame(int level) {
+	if (!Bench.enabled) {
+		return;
+	}
+	CommitFrame();
+
+	if (!Bench.numLevels || Bench.levels[Bench.numLevels - 1].level != level) {
+		if (Bench.numLevels == HOST_BENCH_MAX_LEVELS) {
+			return;
+		}
+		HostBenchLevel& added = Bench.levels[Bench.numLevels++];
+		memset(&added, 0, sizeof(added));
+		added.level = level;
+	}
+
+	memset(Bench.phases, 0, sizeof(Bench.phases));
+	Bench.inFrame = true;
+	Bench.last = GetNanos();
+}
+
+void Host_BenchPhase(int phase) {
+	if (!Bench.inFrame) {
+		return;
+	}
+
+	unsigned long long now = GetNanos();
+	Bench.phases[phase] += (unsigned int)(now - Bench.last);
+	Bench.last = now;
+}
+
+// the fill loops graphx used before the word wide kernels, reading the color through a pointer
+// the way they read GFX.CurColor
+static uint16_t RefBuffer[gfx_lcdWidth * gfx_lcdHeight];
+static uint16_t RefColor = 0x1234;
+
+static void RefFillRectangle(const uint16_t* color, int x, int y, int width, int height) {
+	uint16_t* targetLine = RefBuffer + gfx_lcdWidth * y + x;
+	for (int y0 = 0; y0 < height; y0++) {
+		for (int x0 = 0; x0 < width; x0++) {
+			targetLine[x0] = *color;
+		}
+		targetLine += gfx_lcdWidth;
+	}
+}
+
+static void RefRectangle(const uint16_t* color, int x, int y, int width, int height) {
+	uint16_t* targetLine = RefBuffer + gfx_lcdWidth * y + x;
+	for (int x0 = 0; x0 < width; x0++) {
+		targetLine[x0] = *color;
+	}
+	targetLine += gfx_lcdWidth;
+	for (int y0 = 1; y0 + 1 < height; y0++) {
+		targetLine[0] = *color;
+		targetLine[width - 1] = *color;
+		targetLine += gfx_lcdWidth;
+	}
+	for (int x0 = 0; x0 < width; x0++) {
+		targetLine[x0] = *color;
+	}
+}
+
+struct HostFillCase {
+	const char* name;
+	bool outline;
+	int x, y, width, height;
+};
+
+// megapixels per second of a fill, repeated for at least 50 ms
+template<typename Fill>
+static double MeasureFill(unsigned int pixels, Fill fill) {
+	unsigned long long start = GetNanos();
+	unsigned long long elapsed = 0;
+	unsigned int runs = 0;
+	while (elapsed < 50000000ull) {
+		for (int i = 0; i < 64; i++) {
+			fill();
+		}
+		runs += 64;
+		elapsed = GetNanos() - start;
+	}
+	return (double) pixels * runs / elapsed * 1000.0;
+}
+
+void Host_BenchFills(void) {
+	static const HostFillCase cases[] = {
+		{ "FillScreen",          false, 0,   0,   gfx_lcdWidth, gfx_lcdHeight },
+		{ "FillRect hud",        false, 6,   179, 308,          35 },
+		{ "FillRect 15x15 odd",  false, 3,   3,   15,           15 },
+		{ "Rectangle hud",       true,  4,   177, 312,          39 },
+	};
+
+	gfx_SetColor(1);
+	fprintf(stdout, "  %-20s %12s %12s\n", "Mpixels/s", "before", "after");
+
+	for (const HostFillCase& fill : cases) {
+		const int x = fill.x, y = fill.y, width = fill.width, height = fill.height;
+		unsigned int pixels = fill.outline ? (width + height) * 2 - 4 : width * height;
+		double before, after;
+
+		if (fill.outline) {
+			before = MeasureFill(pixels, [&]() { RefRectangle(&RefColor, x, y, width, height); });
+			after = MeasureFill(pixels, [&]() { gfx_Rectangle_NoClip(x, y, width, height); });
+		} else {
+			before = MeasureFill(pixels, [&]() { RefFillRectangle(&RefColor, x, y, width, height); });
+			if (width == gfx_lcdWidth && height == gfx_lcdHeight) {
+				after = MeasureFill(pixels, [&]() { gfx_FillScreen(1); });
+			} else {
+				after = MeasureFill(pixels, [&]() { gfx_FillRectangle_NoClip(x, y, width, height); });
+			}
+		}
+
+		fprintf(stdout, "  %-20s %12.1f %12.1f\n", fill.name, before, after);
+	}
+}
@@ -0,0 +1,515 @@
+#include "platform.h"
+#include "debug.h"
+#include "graphx.h"
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <time.h>
+
+// Headless Linux host backend, see host.h
+//
+// usage: oiram [-d data_dir] [-k key_script] [-t seconds] [-r | -p | -b frames [-P pack] | -m] [-T steps] [-f] [-i] [-c] [-s screenshot.ppm]
+//
+//  -d	directory holding the .8xv files (OiramS, OiramT, packs), defaults to the working directory
+//  -k	scripted keypad input, one line per change in key state:
+//		<time in ms> [keycode ...]		# comment
+//	    the listed Prizm keycodes (see keypadc.cpp) are held from that time until the next line
+//  -t	virtual seconds to run before exiting, defaults to the end of the key script or 60 seconds
+//  -r	record the gameplay input of each level to OiramR.8xv in the data directory
+//  -p	play back OiramR.8xv, skipping the level select screen
+//  -b	benchmark: play every level of a pack for the given number of frames of scripted input and
+//	    print the min/median/p99 time of each frame phase per level (see bench.cpp)
+//  -P	pack to benchmark, defaults to OiramPK
+//  -m	fill microbenchmark: prints the pixel throughput of the graphx fills and exits
+//  -T	fast forward: run this many simulation steps per drawn frame (the F6 key cycles it at runtime)
+//  -f	redraw the full tilemap every frame, instead of only the cells that changed
+//  -i	draw into the 8 bit indexed back buffer, resolved through the palette at blit time
+//  -c	checksum every presented line, to compare the output of two builds
+//  -s	write the display at exit as a binary ppm
+//
+// The game loop runs at full speed: waits only advance the virtual clock, and each key poll costs
+// a small fixed amount of virtual time so that busy loops waiting on input always make progress.
+
+#define HOST_KEY_POLL_MICROS 10
+#define HOST_DEFAULT_SECONDS 60
+#define HOST_MAX_KEY_EVENTS 4096
+#define HOST_MAX_KEYS_DOWN 8
+#define HOST_MAX_HANDLES 8
+
+extern "C" {
+#include "replay.h"
+#include "pool.h"
+
+	extern uint8_t turbo_steps;
+
+	int simmain(void);
+}
+
+struct HostKeyEvent {
+	unsigned int micros;
+	unsigned char numKeys;
+	unsigned char keys[HOST_MAX_KEYS_DOWN];
+};
+
+static struct {
+	const char* dataDir;
+
+	// virtual clock
+	unsigned long long micros;
+	unsigned long long limitMicros;
+
+	// key script
+	HostKeyEvent events[HOST_MAX_KEY_EVENTS];
+	int numEvents;
+	int curEvent;
+
+	// present stats
+	bool checksum;
+	unsigned int hash;
+	const char* screenshot;
+	unsigned int frames;
+	unsigned int lines;
+	unsigned int startWall;
+	unsigned int lastFrameWall;
+	unsigned int maxFrameWall;
+
+	// step scheduler stats
+	unsigned int skippedSteps;
+	unsigned int droppedTicks;
+} Host = { "." };
+
+static unsigned short Display[HOST_DISPLAY_WIDTH * HOST_DISPLAY_HEIGHT];
+static unsigned short VRAM[LCD_WIDTH_PX * LCD_HEIGHT_PX];
+static FILE* Handles[HOST_MAX_HANDLES] = { 0 };
+
+unsigned int Host_GetMicros(void) {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned int)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+}
+
+static void WriteScreenshot(const char* path) {
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		return;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", HOST_DISPLAY_WIDTH, HOST_DISPLAY_HEIGHT);
+	for (int i = 0; i < HOST_DISPLAY_WIDTH * HOST_DISPLAY_HEIGHT; i++) {
+		unsigned short color = Display[i];
+		fputc(((color >> 11) & 0x1F) << 3, file);
+		fputc(((color >> 5) & 0x3F) << 2, file);
+		fputc((color & 0x1F) << 3, file);
+	}
+	fclose(file);
+}
+
+static void ReportStats() {
+	// the last blit may not have reached the display yet
+	gfx_End();
+
+	unsigned int wall = Host_GetMicros() - Host.startWall;
+	if (Host.screenshot) {
+		WriteScreenshot(Host.screenshot);
+	}
+	fprintf(stderr, "host: %u frames (%u lines) in %.2f virtual s, %.2f wall ms",
+		Host.frames, Host.lines, Host.micros / 1000000.0, wall / 1000.0);
+	if (Host.frames) {
+		fprintf(stderr, ", %u us/frame avg, %u us max", wall / Host.frames, Host.maxFrameWall);
+	}
+	if (Host.skippedSteps || Host.droppedTicks) {
+		fprintf(stderr, ", %u steps undrawn, %u ticks dropped", Host.skippedSteps, Host.droppedTicks);
+	}
+	if (Host.checksum) {
+		fprintf(stderr, ", checksum %08x", Host.hash);
+	}
+	fprintf(stderr, "\n");
+
+	// peak entity counts, and how close each pool came to full in the level it was sized for
+	fprintf(stderr, "host: pool high water");
+	for (int i = 0; i < NUM_POOLS; i++) {
+		fprintf(stderr, "%s %s %u (%u spare)", i ? "," : "", pool[i].name, pool[i].high_water, pool[i].low_spare);
+	}
+	fprintf(stderr, "\n");
+}
+
+static void AdvanceTime(unsigned int micros) {
+	Host.micros += micros;
+	if (Host.micros >= Host.limitMicros) {
+		exit(0);
+	}
+
+	while (Host.curEvent + 1 < Host.numEvents && Host.events[Host.curEvent + 1].micros <= Host.micros) {
+		Host.curEvent++;
+	}
+}
+
+static bool LoadKeyScript(const char* path) {
+	FILE* file = fopen(path, "r");
+	if (!file) {
+		return false;
+	}
+
+	char line[256];
+	while (fgets(line, sizeof(line), file) && Host.numEvents < HOST_MAX_KEY_EVENTS) {
+		char* comment = strchr(line, '#');
+		if (comment) *comment = 0;
+
+		char* cur = line;
+		char* end;
+		long value = strtol(cur, &end, 10);
+		if (end == cur) {
+			continue;
+		}
+
+		HostKeyEvent& event = Host.events[Host.numEvents++];
+		event.micros = (unsigned int)(value * 1000);
+		event.numKeys = 0;
+		for (cur = end, value = strtol(cur, &end, 10); end != cur; cur = end, value = strtol(cur, &end, 10)) {
+			if (event.numKeys < HOST_MAX_KEYS_DOWN) {
+				event.keys[event.numKeys++] = (unsigned char)value;
+			}
+		}
+	}
+
+	fclose(file);
+	return true;
+}
+
+extern "C" {
+
+// returns true if the key is down in the current key script entry
+bool keyDown_fast(unsigned char keyCode) {
+	AdvanceTime(HOST_KEY_POLL_MICROS);
+
+	if (Host.numEvents == 0 || Host.events[Host.curEvent].micros > Host.micros) {
+		return false;
+	}
+
+	const HostKeyEvent& event = Host.events[Host.curEvent];
+	for (int i = 0; i < event.numKeys; i++) {
+		if (event.keys[i] == keyCode) {
+			return true;
+		}
+	}
+	return false;
+}
+
+unsigned short* Host_GetDisplay(void) {
+	return Display;
+}
+
+void Host_PresentLines(int y1, int h) {
+	Host.lines += h;
+
+	if (Host.checksum) {
+		// fnv-1a over the index and contents of each line, so it doesn't depend on how the lines
+		// were split between presents
+		const unsigned short* line = Display + HOST_DISPLAY_WIDTH * y1;
+		for (int y = y1; y < y1 + h; y++) {
+			Host.hash = (Host.hash ^ y) * 16777619u;
+			for (int i = 0; i < HOST_DISPLAY_WIDTH; i++) {
+				Host.hash = (Host.hash ^ *line++) * 16777619u;
+			}
+		}
+	}
+
+	// a new frame starts with each present from the top of the screen
+	if (y1 == 0) {
+		unsigned int now = Host_GetMicros();
+		if (Host.frames) {
+			unsigned int frameTime = now - Host.lastFrameWall;
+			if (frameTime > Host.maxFrameWall) Host.maxFrameWall = frameTime;
+		}
+		Host.lastFrameWall = now;
+		Host.frames++;
+	}
+}
+
+void Host_FrameSteps(unsigned int steps, unsigned int droppedTicks) {
+	Host.skippedSteps += steps - 1;
+	Host.droppedTicks += droppedTicks;
+}
+
+// display
+
+void* GetVRAMAddress(void) {
+	return VRAM;
+}
+
+void Bdisp_EnableColor(int n) {
+}
+
+void Bdisp_Fill_VRAM(int color, int mode) {
+	for (int i = 0; i < LCD_WIDTH_PX * LCD_HEIGHT_PX; i++) {
+		VRAM[i] = (unsigned short)color;
+	}
+}
+
+void Bdisp_PutDisp_DD(void) {
+}
+
+void EnableStatusArea(int opt) {
+}
+
+void DrawFrame(int color) {
+}
+
+int GetKey(int* key) {
+	// wait for any scripted key
+	while (1) {
+		AdvanceTime(10000);
+		for (int i = 27; i <= 79; i++) {
+			if (keyDown_fast(i)) {
+				*key = i;
+				return 1;
+			}
+		}
+	}
+}
+
+// rtc / system
+
+int RTC_GetTicks(void) {
+	return (int)(Host.micros * 128 / 1000000);
+}
+
+void CMT_Delay_100micros(int n) {
+	AdvanceTime(n * 100);
+}
+
+// files
+
+static void GetHostPath(char* dest, const unsigned short* filename) {
+	char name[256];
+	Bfile_NameToStr_ncpy(name, filename, sizeof(name));
+
+	// strip the storage memory device
+	const char* sep = strrchr(name, '\\');
+	sprintf(dest, "%s/%s", Host.dataDir, sep ? sep + 1 : name);
+}
+
+int Bfile_OpenFile_OS(const unsigned short* filename, int mode, int zero) {
+	char path[512];
+	GetHostPath(path, filename);
+
+	for (int i = 0; i < HOST_MAX_HANDLES; i++) {
+		if (!Handles[i]) {
+			Handles[i] = fopen(path, mode == READ ? "rb" : "r+b");
+			return Handles[i] ? i : -1;
+		}
+	}
+
+	return -1;
+}
+
+int Bfile_CloseFile_OS(int handle) {
+	if (handle < 0 || handle >= HOST_MAX_HANDLES || !Handles[handle]) {
+		return -1;
+	}
+
+	fclose(Handles[handle]);
+	Handles[handle] = NULL;
+	return 0;
+}
+
+int Bfile_ReadFile_OS(int handle, void* buf, int size, int readpos) {
+	if (handle < 0 || handle >= HOST_MAX_HANDLES || !Handles[handle]) {
+		return -1;
+	}
+
+	if (readpos >= 0) {
+		fseek(Handles[handle], readpos, SEEK_SET);
+	}
+	return (int)fread(buf, 1, size, Handles[handle]);
+}
+
+int Bfile_WriteFile_OS(int handle, const void* buf, int size) {
+	if (handle < 0 || handle >= HOST_MAX_HANDLES || !Handles[handle]) {
+		return -1;
+	}
+
+	fwrite(buf, 1, size, Handles[handle]);
+	return (int)ftell(Handles[handle]);
+}
+
+int Bfile_GetFileSize_OS(int handle) {
+	if (handle < 0 || handle >= HOST_MAX_HANDLES || !Handles[handle]) {
+		return -1;
+	}
+
+	FILE* file = Handles[handle];
+	long pos = ftell(file);
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, pos, SEEK_SET);
+	return (int)size;
+}
+
+int Bfile_CreateEntry_OS(const unsigned short* filename, int mode, size_t* size) {
+	char path[512];
+	GetHostPath(path, filename);
+
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < *size; i++) {
+		fputc(0, file);
+	}
+	fclose(file);
+	return 0;
+}
+
+int Bfile_DeleteEntry(const unsigned short* filename) {
+	char path[512];
+	GetHostPath(path, filename);
+	return remove(path);
+}
+
+void Bfile_StrToName_ncpy(unsigned short* dest, const char* source, size_t n) {
+	size_t i;
+	for (i = 0; i < n && source[i]; i++) {
+		dest[i] = (unsigned char)source[i];
+	}
+	if (i < n) dest[i] = 0;
+}
+
+void Bfile_NameToStr_ncpy(char* dest, const unsigned short* source, size_t n) {
+	size_t i;
+	for (i = 0; i < n && source[i]; i++) {
+		dest[i] = (char)source[i];
+	}
+	if (i < n) dest[i] = 0;
+}
+
+static DIR* FindDir = NULL;
+static char FindPattern[256];
+
+int Bfile_FindNext(int FindHandle, char* foundfile, char* fileinfo) {
+	if (!FindDir) {
+		return -1;
+	}
+
+	while (dirent* entry = readdir(FindDir)) {
+		if (fnmatch(FindPattern, entry->d_name, 0) == 0) {
+			Bfile_StrToName_ncpy((unsigned short*)foundfile, entry->d_name, 0xFF);
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+int Bfile_FindFirst(const char* pathname, int* FindHandle, char* foundfile, void* fileinfo) {
+	char name[256];
+	Bfile_NameToStr_ncpy(name, (const unsigned short*)pathname, sizeof(name));
+	const char* sep = strrchr(name, '\\');
+	strcpy(FindPattern, sep ? sep + 1 : name);
+
+	if (FindDir) closedir(FindDir);
+	FindDir = opendir(Host.dataDir);
+	*FindHandle = 0;
+	return Bfile_FindNext(0, foundfile, (char*)fileinfo);
+}
+
+int Bfile_FindClose(int FindHandle) {
+	if (FindDir) {
+		closedir(FindDir);
+		FindDir = NULL;
+	}
+	return 0;
+}
+
+// fonts
+
+const CalcTypeFont arial_small = { 11, 6 };
+
+int CalcType_Width(const CalcTypeFont* font, const char* string) {
+	return (int)strlen(string) * font->advance;
+}
+
+void CalcType_Draw(const CalcTypeFont* font, const char* string, int x, int y, unsigned short color, unsigned char* buffer, int pitch) {
+	unsigned short* target = (unsigned short*)buffer;
+	int width = pitch;
+	int height = HOST_DISPLAY_HEIGHT;
+	if (!target) {
+		target = VRAM;
+		width = pitch = LCD_WIDTH_PX;
+		height = LCD_HEIGHT_PX;
+	}
+
+	// each visible character is a solid cell, leaving a pixel of spacing on the right and bottom
+	for (; *string; string++, x += font->advance) {
+		if (*string == ' ') continue;
+
+		for (int curY = max(y, 0); curY < min(y + font->height - 1, height); curY++) {
+			for (int curX = max(x, 0); curX < min(x + font->advance - 1, width); curX++) {
+				target[curY * pitch + curX] = color;
+			}
+		}
+	}
+}
+
+};
+
+int main(int argc, char** argv) {
+	const char* keyScript = NULL;
+	const char* benchPack = "OiramPK";
+	unsigned int benchFrames = 0;
+	double seconds = 0;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "d:k:t:rpb:P:mT:fics:")) != -1) {
+		switch (opt) {
+			case 'd': Host.dataDir = optarg; break;
+			case 'k': keyScript = optarg; break;
+			case 't': seconds = atof(optarg); break;
+			case 'r': replay_mode = REPLAY_RECORD; break;
+			case 'p': replay_mode = REPLAY_PLAY; break;
+			case 'b': benchFrames = (unsigned int)atoi(optarg); break;
+			case 'P': benchPack = optarg; break;
+			case 'm': Host_BenchFills(); return 0;
+			case 'T': turbo_steps = (uint8_t)max(atoi(optarg), 1); break;
+			case 'f': gfx_SetTilemapDirtyTracking(false); break;
+			case 'i': gfx_SetIndexedBuffer(true); break;
+			case 'c': Host.checksum = true; break;
+			case 's': Host.screenshot = optarg; break;
+			default:
+				fprintf(stderr, "usage: %s [-d data_dir] [-k key_script] [-t seconds] [-r | -p | -b frames [-P pack] | -m] [-T steps] [-f] [-i] [-c] [-s screenshot.ppm]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (keyScript && !LoadKeyScript(keyScript)) {
+		fprintf(stderr, "host: could not read key script %s\n", keyScript);
+		return 1;
+	}
+
+	if (benchFrames) {
+		if (!replay_bench(benchPack, benchFrames)) {
+			fprintf(stderr, "host: could not set up a benchmark of %s\n", benchPack);
+			return 1;
+		}
+		Host_BenchBegin();
+		atexit(Host_BenchReport);
+	}
+
+	if (seconds > 0) {
+		Host.limitMicros = (unsigned long long)(seconds * 1000000);
+	} else if (benchFrames) {
+		Host.limitMicros = ~0ull;
+	} else if (Host.numEvents) {
+		Host.limitMicros = Host.events[Host.numEvents - 1].micros;
+	} else {
+		Host.limitMicros = HOST_DEFAULT_SECONDS * 1000000ull;
+	}
+
+	Host.hash = 2166136261u;
+	Host.startWall = Host_GetMicros();
+	atexit(ReportStats);
+
+	return simmain();
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// Headless Linux host backend. Stands in for the subset of the PrizmSDK fxcg and calctype
+// libraries the game uses so it can be built with a stock gcc (see host.mk) and run without
+// a display: VRAM is an in memory buffer, files come from a local directory, keys come from
+// a script and time is a virtual clock that only advances when the game waits on it.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// display (fxcg/display.h)
+#define LCD_WIDTH_PX 384
+#define LCD_HEIGHT_PX 216
+
+#define COLOR_BLACK 0x0000
+#define COLOR_WHITE 0xFFFF
+
+void* GetVRAMAddress(void);
+void Bdisp_EnableColor(int n);
+void Bdisp_Fill_VRAM(int color, int mode);
+void Bdisp_PutDisp_DD(void);
+void EnableStatusArea(int opt);
+void DrawFrame(int color);
+
+// keyboard (fxcg/keyboard.h)
+#define KEY_CTRL_EXE 30004
+#define KEY_CTRL_EXIT 30002
+#define KEY_CTRL_MENU 30003
+
+int GetKey(int* key);
+
+// rtc / system (fxcg/rtc.h, fxcg/system.h)
+int RTC_GetTicks(void);
+void CMT_Delay_100micros(int n);
+
+// files (fxcg/file.h), \\fls0\ names map into the host data directory
+#define READ 0
+#define WRITE 1
+#define READWRITE 2
+#define CREATEMODE_FILE 1
+
+int Bfile_OpenFile_OS(const unsigned short* filename, int mode, int zero);
+int Bfile_CloseFile_OS(int handle);
+int Bfile_ReadFile_OS(int handle, void* buf, int size, int readpos);
+int Bfile_WriteFile_OS(int handle, const void* buf, int size);
+int Bfile_GetFileSize_OS(int handle);
+int Bfile_CreateEntry_OS(const unsigned short* filename, int mode, size_t* size);
+int Bfile_DeleteEntry(const unsigned short* filename);
+void Bfile_StrToName_ncpy(unsigned short* dest, const char* source, size_t n);
+void Bfile_NameToStr_ncpy(char* dest, const unsigned short* source, size_t n);
+int Bfile_FindFirst(const char* pathname, int* FindHandle, char* foundfile, void* fileinfo);
+int Bfile_FindNext(int FindHandle, char* foundfile, char* fileinfo);
+int Bfile_FindClose(int FindHandle);
+
+// fonts (calctype), glyphs are drawn as solid cells of a fixed advance
+typedef struct {
+	int height;
+	int advance;
+} CalcTypeFont;
+
+extern const CalcTypeFont arial_small;
+
+int CalcType_Width(const CalcTypeFont* font, const char* string);
+void CalcType_Draw(const CalcTypeFont* font, const char* string, int x, int y, unsigned short color, unsigned char* buffer, int pitch);
+
+// host only interface
+#define HOST_DISPLAY_WIDTH 320
+#define HOST_DISPLAY_HEIGHT 224
+
+// the presented display, as last written by the graphx blits
+unsigned short* Host_GetDisplay(void);
+
+// reports h lines starting at y1 were sent to the display (one frame is counted per blit touching line 0)
+void Host_PresentLines(int y1, int h);
+
+// reports a frame of the step scheduler: the simulation steps it ran, of which only the last was
+// drawn, and the RTC ticks it dropped for being too far behind
+void Host_FrameSteps(unsigned int steps, unsigned int droppedTicks);
+
+// monotonic wall clock in microseconds, for measuring actual host cost
+unsigned int Host_GetMicros(void);
+
+// benchmark frame phases (bench.cpp), the game loop marks the end of each with Host_BenchPhase
+enum HostBenchPhases {
+	HOST_BENCH_MOVE,
+	HOST_BENCH_TILEMAP,
+	HOST_BENCH_EVENTS,
+	HOST_BENCH_SPRITES,
+	HOST_BENCH_ANIMATE,
+	HOST_BENCH_BLIT,
+	HOST_BENCH_OTHER,
+	HOST_BENCH_PHASES
+};
+
+void Host_BenchBegin(void);
+void Host_BenchReport(void);
+
+// fill kernel microbenchmark, prints pixel throughput
+void Host_BenchFills(void);
+
+// starts timing a frame of the given level, the time since the last mark is charged to phase
+void Host_BenchFrame(int level);
+void Host_BenchPhase(int phase);
+
+#ifdef __cplusplus
+}
+#endif
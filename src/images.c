@@ -14,6 +14,12 @@
 
 gfx_sprite_t *tileset_tiles[256];
 
+// blocks of sprite data drawn from resolved colors
+enum resolved_blocks {
+    RESOLVED_TILES=0,
+    RESOLVED_SPRITES
+};
+
 gfx_sprite_t oiram_0_buffer_left[27*27 + 2];
 gfx_sprite_t oiram_1_buffer_left[27*27 + 2];
 gfx_sprite_t oiram_0_buffer_right[27*27 + 2];
@@ -203,6 +209,10 @@ void extract_tiles(void) {
         tiles[i] = (gfx_sprite_t*)tmp_ptr;
         tmp_ptr += TILE_DATA_SIZE;
     }
+
+    // keep the tiles resolved to screen colors, and find the single color ones
+    gfx_ResolveSprites(RESOLVED_TILES, tile_question_box, 252 * TILE_DATA_SIZE);
+    gfx_ClassifyTiles(tile_question_box, 252, TILE_DATA_SIZE);
     
     // close the open file
     ti_CloseAll();
@@ -250,6 +260,9 @@ void extract_sprites(void) {
     slot = ti_Open("OiramS", "r", -1);
     if (slot) {
         uint8_t *spr_ptr = ti_GetDataPtr(slot);
+
+        // keep the sprites resolved to screen colors
+        gfx_ResolveSprites(RESOLVED_SPRITES, spr_ptr, ti_GetSize(slot));
         
         oiram_0_small = (gfx_sprite_t*)spr_ptr;
         spr_ptr += 258;
@@ -460,6 +473,13 @@ void extract_sprites(void) {
         reswob_down = (gfx_rletsprite_t*)spr_ptr;
         spr_ptr += 1029;
         oiram_start = (gfx_sprite_t*)spr_ptr;
+
+        // reswob is large and often clipped at the screen edges
+        gfx_IndexRLETSprite(reswob_left_0);
+        gfx_IndexRLETSprite(reswob_left_1);
+        gfx_IndexRLETSprite(reswob_right_0);
+        gfx_IndexRLETSprite(reswob_right_1);
+        gfx_IndexRLETSprite(reswob_down);
     } else {
         missing_appvars();
     }
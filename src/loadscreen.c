@@ -11,6 +11,8 @@
 #include "oiram.h"
 #include "lower.h"
 #include "simple_mover.h"
+#include "replay.h"
+#include "pool.h"
 
 #include <string.h>
 #include <stdbool.h>
@@ -240,7 +242,8 @@ void set_level(char *name, uint8_t level) {
         decode(pack_data, tilemap.map);
     }
 
-    if (!level_width || !level_height) {
+    // the entity pools are sized from the map, and have to fit in the heap along with it
+    if (!level_width || !level_height || !pool_setup(tilemap.map, level_width * level_height)) {
         save_progress();
         exit(0);
     }
@@ -364,6 +367,8 @@ redraw_screen:
 	gfx_PrintStringXY("[MENU] Quit", 9, 208);
 
 	gfx_PrintStringXY("Press <> to select level", 150, 184);
+	gfx_PrintStringXY(replay_mode == REPLAY_RECORD ? "[F1] Recording: On" : "[F1] Recording: Off", 150, 196);
+	gfx_PrintStringXY("[F2] Play Recording", 150, 208);
 
 	tmp = 0;
 	num_packs = 0;
@@ -436,7 +441,7 @@ redraw_screen:
 
 		// don't debounce exit
 		if (kb_Data[EXIT_KEY_GROUP] == EXIT_KEY) {
-#if TARGET_WINSIM
+#if TARGET_WINSIM || TARGET_HOST
 			exit(0);
 #endif
 			kb_Scan_with_GetKey();
@@ -451,6 +456,16 @@ redraw_screen:
 		if (grp6 == kb_Enter || _grp1 == kb_2nd) {
 			break;
 		}
+		if (_grp1 == kb_Yequ) {
+			// toggle input recording for the levels that follow
+			replay_mode = replay_mode == REPLAY_RECORD ? REPLAY_OFF : REPLAY_RECORD;
+			goto redraw_screen;
+		}
+		if (_grp1 == kb_Window) {
+			// play back the last recording, which picks its own levels
+			replay_mode = REPLAY_PLAY;
+			break;
+		}
 		if (_grp1 == kb_Mode) {
 			uint8_t newRun, newJump, newAttack, newDuck, newLeft, newRight, newPause;
 			if (!GetMapKey(&newJump, "JUMP")) goto redraw_screen;
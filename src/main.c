@@ -11,6 +11,9 @@
 #include "images.h"
 #include "simple_mover.h"
 #include "tile_handlers.h"
+#include "replay.h"
+#include "pool.h"
+#include "grid.h"
 
 #include <stdbool.h>
 
@@ -23,12 +26,29 @@
 #include "keypadc.h"
 #include "fileioc.h"
 
+#if TARGET_HOST
+// frame phase timing for the host benchmark, see host/bench.cpp
+#define bench_frame() Host_BenchFrame(game.level)
+#define bench_phase(phase) Host_BenchPhase(HOST_BENCH_##phase)
+#define report_steps(steps, dropped) Host_FrameSteps(steps, dropped)
+#else
+#define bench_frame()
+#define bench_phase(phase)
+#define report_steps(steps, dropped)
+#endif
+
 map_t level_map;
 tiles_struct_t tiles;
 gfx_tilemap_t tilemap;
 oiram_t oiram;
 game_t game;
 
+// the RTC tick the simulation has caught up to, see the step scheduler in the main loop
+static int step_ticks;
+
+// steps run per drawn frame in fast forward, 1 is off
+uint8_t turbo_steps = 1;
+
 void double_rectangle(uint24_t x, uint8_t y, uint24_t width, uint8_t height);
 
 bool easter_egg1;
@@ -76,15 +96,18 @@ void handler_keypad(void) {
     bool press_up, pressed_s;
 	static bool pressed_special = false;
 
-    pressed_2nd     = keyDown_fast(game.runKey);
+    // keys are read once per frame through the replay system so sessions can be recorded
+    uint8_t keys    = replay_keys();
+
+    pressed_2nd     = (keys & REPLAY_KEY_RUN) != 0;
 
-    pressed_down    = keyDown_fast(game.duckKey);
-    pressed_left    = keyDown_fast(game.leftKey);
-    pressed_right   = keyDown_fast(game.rightKey);
+    pressed_down    = (keys & REPLAY_KEY_DUCK) != 0;
+    pressed_left    = (keys & REPLAY_KEY_LEFT) != 0;
+    pressed_right   = (keys & REPLAY_KEY_RIGHT) != 0;
 
-    pressed_s       = keyDown_fast(game.attackKey);
+    pressed_s       = (keys & REPLAY_KEY_ATTACK) != 0;
 
-    press_up        = keyDown_fast(game.jumpKey);
+    press_up        = (keys & REPLAY_KEY_JUMP) != 0;
 
     if (allow_up_press) {
         pressed_up = press_up;
@@ -102,8 +125,8 @@ void handler_keypad(void) {
     }
     pressed_special = pressed_s;
 
-    if (keyDown_fast(48)) {
-		while (keyDown_fast(48)) {}
+    if (keys & REPLAY_KEY_MENU) {
+		while (replay_mode != REPLAY_PLAY && keyDown_fast(48)) {}
 
         if (!oiram.failed) {
             game.exit = true;
@@ -111,8 +134,8 @@ void handler_keypad(void) {
         }
     }
 
-	if (keyDown_fast(game.pauseKey)) {
-		while (keyDown_fast(game.pauseKey)) {}
+	if (keys & REPLAY_KEY_PAUSE) {
+		while (replay_mode != REPLAY_PLAY && keyDown_fast(game.pauseKey)) {}
 
 		double_rectangle(80, 100, 160, 20);
 
@@ -122,8 +145,13 @@ void handler_keypad(void) {
 		gfx_PrintStringXY(str1, 160 - width / 2, 105);
 		gfx_BlitBuffer();
 
-		while (os_GetCSC() == 0) {}
-		while (os_GetCSC()) {}
+		if (replay_mode != REPLAY_PLAY) {
+			while (os_GetCSC() == 0) {}
+			while (os_GetCSC()) {}
+
+			// don't try to catch up on the time spent paused
+			step_ticks = RTC_GetTicks();
+		}
 	}
 }
 
@@ -181,7 +209,7 @@ static void extract_images(void) {
     }
 }
 
-#if TARGET_WINSIM
+#if TARGET_WINSIM || TARGET_HOST
 int simmain(void) {
 #else
 int main(void) {
@@ -220,11 +248,18 @@ int main(void) {
 
 HANDLE_MAIN_START:
 
-    // load the splash screen
-    set_load_screen();
+    // load the splash screen, replays go straight to their next level
+    if (replay_mode != REPLAY_PLAY) {
+        set_load_screen();
+    }
 
 HANDLE_DRAW_LEVEL:
 
+    // record the level start, or load it from the replay
+    if (!replay_begin_level()) {
+        goto HANDLE_EXIT;
+    }
+
     // extract palette and tiles/sprites
     extract_images();
 
@@ -272,6 +307,7 @@ HANDLE_DRAW_LEVEL:
 
     // load all the enemies in the level
     set_level(game.packVar, game.level);
+    setup_grids();
     get_enemies();
     oiram_start_location();
 
@@ -296,7 +332,7 @@ HANDLE_DRAW_LEVEL:
     delay(400);
 
     // set up the timer
-	int curTicks = RTC_GetTicks();
+	int curTicks = replay_sync_ticks(RTC_GetTicks());
 	/*
     timer_Control = TIMER1_DISABLE;
     timer_1_ReloadValue = timer_1_Counter = 32768;
@@ -318,59 +354,116 @@ HANDLE_DRAW_LEVEL:
         animate();
     }
 
+    // the simulation advances SIM_STEP_TICKS per step whatever the frame rate. when frames run long
+    // the steps that are due run back to back, drawing only the last, and anything past
+    // MAX_FRAME_SKIP undrawn steps is dropped so the game slows down rather than stalls. fast
+    // forward runs turbo_steps steps a frame the same way, but back to back with no waiting
+    int simTicks = curTicks;
+    step_ticks = RTC_GetTicks();
+
     // wait until the clear key is pressed
     while(!game.exit) {
+        static bool turbo_down = false;
+        unsigned int steps = turbo_steps;
+        unsigned int dropped = 0;
+
+        // cycle fast forward on each press of the turbo key
+        if (keyDown_fast(TURBO_KEY)) {
+            if (!turbo_down) {
+                turbo_steps = turbo_steps >= TURBO_MAX_STEPS ? 1 : turbo_steps * 2;
+            }
+            turbo_down = true;
+        } else {
+            turbo_down = false;
+        }
 
-        // handle keypad presses
-        handle_keypad();
+        // replays and fast forward run as fast as possible, otherwise wait for the next step
+        if (replay_mode == REPLAY_PLAY || steps > 1) {
+            step_ticks = RTC_GetTicks();
+        } else {
+            int ticks;
+            while ((ticks = RTC_GetTicks()) - step_ticks < SIM_STEP_TICKS) {
+                CMT_Delay_100micros(10);
+            }
+            steps = (ticks - step_ticks) / SIM_STEP_TICKS;
+            if (steps > MAX_FRAME_SKIP + 1) {
+                dropped = (steps - MAX_FRAME_SKIP - 1) * SIM_STEP_TICKS;
+                steps = MAX_FRAME_SKIP + 1;
+            }
+            step_ticks += steps * SIM_STEP_TICKS + dropped;
+        }
+        report_steps(steps, dropped);
 
-        // move oiram if requested
-        move_oiram();
+        while (steps-- && !game.exit) {
+            // only the last step of the frame is drawn
+            bool draw = !steps;
 
-        // draw the tilemap at the current oiram offsets
-        gfx_Tilemap(&tilemap, oiram.scrollx, oiram.scrolly);
+            bench_frame();
 
-        // handle outstanding events, such as showing number of coins
-        handle_pending_events();
+            // handle keypad presses
+            handle_keypad();
+            bench_phase(OTHER);
 
-        // handle timer every second
-		int ticks = RTC_GetTicks();
-        if (ticks - curTicks >= 128) {
-            handler_timer();
-			curTicks = ticks;
-//            timer_IntAcknowledge = TIMER1_RELOADED;
-        }
+            // move oiram if requested
+            move_oiram();
+            bench_phase(MOVE);
+
+            // draw the tilemap at the current oiram offsets
+            if (draw) {
+                gfx_Tilemap(&tilemap, oiram.scrollx, oiram.scrolly);
+            }
+            bench_phase(TILEMAP);
+
+            // handle outstanding events, such as showing number of coins
+            update_pending_events(draw);
+            bench_phase(EVENTS);
 
-		// lock to 32 FPS
-		static int lastTicks = 0;
-		while (ticks == lastTicks || ticks == lastTicks + 1 || ticks == lastTicks + 2 || ticks == lastTicks + 3) {
-			CMT_Delay_100micros(10);
-			ticks = RTC_GetTicks();
-		};
-		lastTicks = ticks;
+            // and draw what they left on screen
+            if (draw) {
+                draw_pending_events();
+            }
+            bench_phase(SPRITES);
+
+            // handle timer every second
+            simTicks += SIM_STEP_TICKS;
+            int ticks = replay_ticks(simTicks);
+            if (ticks - curTicks >= 128) {
+                handler_timer();
+                curTicks = ticks;
+            }
+            bench_phase(OTHER);
 
-        // blit the draw buffer
-        gfx_BlitLines(gfx_buffer, 0, 178);
+            // blit the draw buffer along with any hud lines that changed this frame
+            if (draw) {
+                gfx_QueueLines(0, 178);
+                gfx_FlushLines();
+            }
+            bench_phase(BLIT);
 
-        // animate the things
-        if (!easter_egg2) {
-            animate();
+            // animate the things
+            if (!easter_egg2) {
+                animate();
+            }
+            bench_phase(ANIMATE);
         }
     }
 
     // timer_Control = TIMER1_DISABLE;
 
+    replay_end_level();
+
     // deallocate
-    while(num_simple_enemies) { remove_simple_enemy(0); }
-    while(num_simple_movers)  { remove_simple_mover(0); }
-    while(num_chompers)       { remove_chomper(0);      }
-    while(num_thwomps)        { remove_thwomp(0);       }
-    while(num_flames)         { remove_flame(0);        }
-    while(num_boos)           { remove_boo(0);          }
-    while(num_poofs)          { remove_poof(0);         }
-    while(num_fireballs)      { remove_fireball(0);     }
-    while(num_bumped_tiles)   { remove_bumped_tile(0);  }
+    while(num_simple_enemies) { remove_simple_enemy(num_simple_enemies - 1); }
+    while(num_simple_movers) { remove_simple_mover(num_simple_movers - 1); }
+    while(num_chompers) { remove_chomper(num_chompers - 1); }
+    while(num_thwomps) { remove_thwomp(num_thwomps - 1); }
+    while(num_flames) { remove_flame(num_flames - 1); }
+    while(num_boos) { remove_boo(num_boos - 1); }
+    while(num_poofs) { remove_poof(num_poofs - 1); }
+    while(num_fireballs) { remove_fireball(num_fireballs - 1); }
+    while(num_bumped_tiles) { remove_bumped_tile(num_bumped_tiles - 1); }
     free(tilemap.map);
+    pool_release();
 
     gfx_SetColor(BLACK_INDEX);
 
@@ -458,7 +551,7 @@ HANDLE_PACK_FINISH:
         }
         gfx_BlitBuffer();
         delay(22);
-    } while (os_GetCSC() != sk_Enter);
+    } while (replay_mode != REPLAY_PLAY && os_GetCSC() != sk_Enter);
 	while (os_GetCSC()) {}
 
     // debounce
@@ -467,8 +560,12 @@ HANDLE_PACK_FINISH:
     goto HANDLE_MAIN_START;
 
 HANDLE_EXIT:
-    // save the pack states
-    save_progress();
+    // save the pack states, unless they came from a replay
+    if (replay_mode != REPLAY_PLAY) {
+        save_progress();
+    } else {
+        gfx_End();
+    }
 
 	return 0;
 }
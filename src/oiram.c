@@ -19,6 +19,7 @@
 #include "lower.h"
 #include "oiram.h"
 #include "simple_mover.h"
+#include "grid.h"
 
 bool pressed_left = false;
 bool pressed_right = false;
@@ -70,7 +71,8 @@ void set_normal_oiram_sprites(void) {
 
 // handle picking up of a shell
 static bool pickup_shell(void) {
-    uint8_t j;
+    uint8_t found[GRID_MAX_FOUND];
+    uint8_t j, k, num_found;
 
     // get absolute locations
     int abs_x = oiram.x;
@@ -89,12 +91,19 @@ static bool pickup_shell(void) {
     }
 
     // check if there is a shell near oiram
-    for(j = 0; j < num_simple_movers; j++) {
-        simple_move_t *chk = simple_mover[j];
-        uint8_t chk_type = chk->type;
+    num_found = query_grid(GRID_SIMPLE_MOVERS, abs_x, abs_x + 24, found);
+    for(k = 0; k < num_found; k++) {
+        simple_move_t *chk = simple_mover[j = found[k]];
+        uint8_t chk_type;
 
-        if ((chk_type == KOOPA_RED_SHELL_TYPE || chk_type == KOOPA_GREEN_SHELL_TYPE) && !chk->vx) {
-            if (gfx_CheckRectangleHotspot(abs_x, abs_y, 24, oiram.hitbox.height, chk->x, chk->y, 15, 15)) {
+        if (!chk) {
+            continue;
+        }
+
+        chk_type = chk->type;
+
+        if ((chk_type == KOOPA_RED_SHELL_TYPE || chk_type == KOOPA_GREEN_SHELL_TYPE) && !movers.vx[chk->slot]) {
+            if (gfx_CheckRectangleHotspot(abs_x, abs_y, 24, oiram.hitbox.height, movers.x[chk->slot], movers.y[chk->slot], 15, 15)) {
                 remove_simple_mover(j);
                 oiram.has_shell = true;
                 oiram.has_red_shell = chk_type == KOOPA_RED_SHELL_TYPE;
@@ -110,17 +119,17 @@ static bool pickup_shell(void) {
 // drops a shell if oiram is holding one
 static void drop_shell(void) {
     simple_move_t *shell = add_simple_mover(NULL);
-    shell->y = ((oiram.flags & FLAG_OIRAM_BIG) ? oiram.y + 26/2 - 4 : oiram.y);
+    movers.y[shell->slot] = ((oiram.flags & FLAG_OIRAM_BIG) ? oiram.y + 26/2 - 4 : oiram.y);
     if (oiram.direction == FACE_LEFT) {
-        shell->vx = -3;
-        shell->x = -16;
+        movers.vx[shell->slot] = -3;
+        movers.x[shell->slot] = -16;
     } else {
-        shell->vx = 3;
-        shell->x = OIRAM_HITBOX_WIDTH;
+        movers.vx[shell->slot] = 3;
+        movers.x[shell->slot] = OIRAM_HITBOX_WIDTH;
     }
-    shell->x += oiram.x;
-    shell->hitbox.height = 15;
-    shell->hitbox.width = 15;
+    movers.x[shell->slot] += oiram.x;
+    movers.hitbox[shell->slot].height = 15;
+    movers.hitbox[shell->slot].width = 15;
     if (oiram.has_red_shell) {
         shell->sprite = koopa_red_shell_0;
         shell->type = KOOPA_RED_SHELL_TYPE;
@@ -180,24 +189,27 @@ static void oiram_location_from_offset(unsigned int offset) {
 }
 
 static void spin_racoon_mario(int x, int y) {
-    uint8_t j;
+    uint8_t found[GRID_MAX_FOUND];
+    uint8_t j, k, num_found;
 
-    for(j = 0; j < num_simple_movers; j++) {
-        simple_move_t *hit = simple_mover[j];
+    num_found = query_grid(GRID_SIMPLE_MOVERS, x, x + 8, found);
+    for(k = 0; k < num_found; k++) {
+        simple_move_t *hit = simple_mover[j = found[k]];
 
-        if (hit->type > HITABLE_TYPES) {
-            if (gfx_CheckRectangleHotspot(x, y, 8, 14, hit->x, hit->y, hit->hitbox.width, hit->hitbox.height)) {
+        if (hit && hit->type > HITABLE_TYPES) {
+            if (gfx_CheckRectangleHotspot(x, y, 8, 14, movers.x[hit->slot], movers.y[hit->slot], movers.hitbox[hit->slot].width, movers.hitbox[hit->slot].height)) {
                 add_score(1, x, y);
-                add_poof(hit->x + 4, hit->y + 4);
+                add_poof(movers.x[hit->slot] + 4, movers.y[hit->slot] + 4);
                 remove_simple_mover(j);
-                j = -1;
+                k = -1;
             }
         }
     }
 
-    for(j = 0; j < num_chompers; j++) {
-        chomper_t *hit = chomper[j];
-        if (y + 13 < hit->start_y) {
+    num_found = query_grid(GRID_CHOMPERS, x, x + 8, found);
+    for(k = 0; k < num_found; k++) {
+        chomper_t *hit = chomper[j = found[k]];
+        if (hit && y + 13 < hit->start_y) {
             if (gfx_CheckRectangleHotspot(x, y, 8, 14, hit->x, hit->y, 15, 30)) {
                 add_score(1, x, y);
                 add_poof(hit->x + 4, y);
@@ -442,7 +454,7 @@ HANDLE_REDUCED_SPEED:
                 }
             }
 
-            gfx_BlitLines(gfx_buffer, 187, 2);
+            gfx_QueueLines(187, 2);
         }
 
         // check if no momentum and set sprites
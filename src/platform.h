@@ -4,6 +4,9 @@
 #include "string.h"
 #include "stdlib.h"
 
+#if TARGET_HOST
+#include "host/host.h"
+#else
 #include "fxcg\display.h"
 #include "fxcg\keyboard.h"
 #include "fxcg\file.h"
@@ -11,6 +14,7 @@
 #include "fxcg\rtc.h"
 #include "fxcg\system.h"
 #include "fxcg\serial.h"
+#endif
 
 #include "ce_sim.h"
 
@@ -28,6 +32,12 @@ typedef unsigned int uint32;
 #define RESTRICT __restrict
 #include <time.h>
 #undef LoadImage
+#elif TARGET_HOST
+#define ALIGN(x) __attribute__((aligned(x)))
+#define LITTLE_E
+#define FORCE_INLINE __attribute__((always_inline)) inline
+#define RESTRICT __restrict__
+#include <time.h>
 #else
 
 #define ALIGN(x) __attribute__((aligned(x)))
@@ -0,0 +1,153 @@
+#include "platform.h"
+#include "debug.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#if !TARGET_PRIZM
+#include <stdint.h>
+#endif
+
+#include "pool.h"
+#include "grid.h"
+#include "defines.h"
+#include "enemies.h"
+#include "simple_mover.h"
+#include "tile_handlers.h"
+
+// blocks are unions with a pointer so a freed block can always hold the free list link
+#define POOL(name, type) { name, NULL, NULL, sizeof(union { type block; void *next; }), 0, 0, 0, 0, ~0u }
+
+pool_t pool[NUM_POOLS] = {
+    POOL("simple movers",   simple_move_t),
+    POOL("simple enemies",  enemy_t),
+    POOL("chompers",        chomper_t),
+    POOL("thwomps",         thwomp_t),
+    POOL("flames",          flame_t),
+    POOL("boos",            boo_t),
+    POOL("poofs",           poof_t),
+    POOL("fireballs",       fireball_t),
+    POOL("fireball movers", simple_move_t),
+    POOL("bumped tiles",    bumped_tile_t),
+};
+
+// a pool holds a block for each of the level's own enemies of its kind and this many more for what
+// play adds, such as powerups, shells, scores and bullets, up to what its table holds
+static const struct {
+    uint16_t max;
+    uint8_t extra;
+} pool_limit[NUM_POOLS] = {
+    { MAX_SIMPLE_MOVERS, 16 },
+    { MAX_SIMPLE_ENEMY,  32 },
+    { MAX_CHOMPERS,      0 },
+    { MAX_THWOMPS,       0 },
+    { MAX_FLAMES,        0 },
+    { MAX_BOOS,          0 },
+    { MAX_POOFS,         MAX_POOFS },
+    { MAX_FIREBALLS,     MAX_FIREBALLS },
+    { MAX_FIREBALLS,     MAX_FIREBALLS },
+    { MAX_TILE_BUMPS,    MAX_TILE_BUMPS },
+};
+
+// every pool's blocks, in one allocation from the system heap for the level
+static uint8_t *pool_storage;
+
+bool entity_tombstones;
+
+void *pool_alloc(uint8_t type) {
+    pool_t *cur = &pool[type];
+    void *block;
+
+    // reuse the last freed block, or carve a new one
+    if ((block = cur->free)) {
+        cur->free = *(void**)block;
+    } else if (cur->carved < cur->capacity) {
+        block = cur->storage + cur->carved++ * cur->size;
+    } else {
+        return NULL;
+    }
+
+    if (++cur->used > cur->high_water) {
+        cur->high_water = cur->used;
+    }
+    if (cur->capacity - cur->used < cur->low_spare) {
+        cur->low_spare = cur->capacity - cur->used;
+    }
+    return block;
+}
+
+void pool_free(uint8_t type, void *block) {
+    pool_t *cur = &pool[type];
+
+    *(void**)block = cur->free;
+    cur->free = block;
+    cur->used--;
+}
+
+unsigned int pool_index(uint8_t type, void *block) {
+    return ((uint8_t*)block - pool[type].storage) / pool[type].size;
+}
+
+bool pool_full(uint8_t type) {
+    return pool[type].used == pool[type].capacity;
+}
+
+bool pool_setup(const uint8_t *map, unsigned int map_size) {
+    unsigned int count[NUM_POOLS + 1] = { 0 };
+    unsigned int offset[NUM_POOLS];
+    unsigned int i, total = 0;
+    uint8_t type;
+
+    pool_release();
+
+    for (i = 0; i < map_size; i++) {
+        count[spawn_pool(map[i])]++;
+    }
+    for (type = 0; type < NUM_POOLS; type++) {
+        pool_t *cur = &pool[type];
+        unsigned int capacity = count[type] + pool_limit[type].extra;
+
+        cur->capacity = capacity < pool_limit[type].max ? capacity : pool_limit[type].max;
+        if (cur->capacity < cur->low_spare) {
+            cur->low_spare = cur->capacity;
+        }
+        cur->free = NULL;
+        cur->carved = 0;
+        cur->used = 0;
+
+        // each pool starts on a pointer boundary, the blocks are the size of a pointer or more
+        offset[type] = total = (total + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+        total += cur->capacity * cur->size;
+    }
+
+    if (!(pool_storage = calloc(total, 1))) {
+        return false;
+    }
+    for (type = 0; type < NUM_POOLS; type++) {
+        pool[type].storage = pool_storage + offset[type];
+    }
+    return true;
+}
+
+void pool_release(void) {
+    free(pool_storage);
+    pool_storage = NULL;
+}
+
+void sweep_entity_tables(void) {
+    if (!entity_tombstones) {
+        return;
+    }
+    entity_tombstones = false;
+
+    sweep_table(simple_mover, num_simple_movers);
+    sweep_table(simple_enemy, num_simple_enemies);
+    sweep_table(chomper, num_chompers);
+    sweep_table(thwomp, num_thwomps);
+    sweep_table(flame, num_flames);
+    sweep_table(boo, num_boos);
+    sweep_table(poof, num_poofs);
+    sweep_table(fireball, num_fireballs);
+    sweep_table(bumped_tile, num_bumped_tiles);
+    invalidate_grids();
+}
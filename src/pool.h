@@ -0,0 +1,83 @@
+#ifndef POOL_H
+#define POOL_H
+
+#if !TARGET_PRIZM
+#include <stdint.h>
+#endif
+
+#include <stdbool.h>
+
+// fixed size pools for the entity structs, so spawning and removing during a level never goes
+// through the system heap. the pools are sized from the level when it is loaded, with room for
+// what play adds, and allocated from the heap in one block. an add that finds its pool full does
+// what it does for a full table
+enum entity_pools {
+    POOL_SIMPLE_MOVERS=0,
+    POOL_SIMPLE_ENEMIES,
+    POOL_CHOMPERS,
+    POOL_THWOMPS,
+    POOL_FLAMES,
+    POOL_BOOS,
+    POOL_POOFS,
+    POOL_FIREBALLS,
+    POOL_FIREBALL_MOVERS,
+    POOL_BUMPED_TILES,
+    NUM_POOLS
+};
+
+typedef struct {
+    const char *name;
+    uint8_t *storage;
+    void *free;             // freed blocks, each holding the pointer to the next
+    unsigned int size;
+    unsigned int capacity;
+    unsigned int carved;    // blocks handed out from storage so far, the rest have never been used
+    unsigned int used;
+    unsigned int high_water;
+    unsigned int low_spare;     // the fewest blocks left free in any level
+} pool_t;
+
+extern pool_t pool[NUM_POOLS];
+
+// O(1), returns NULL only when all capacity blocks are in use
+void *pool_alloc(uint8_t type);
+void pool_free(uint8_t type, void *block);
+bool pool_full(uint8_t type);
+
+// where a block is in its pool's storage
+unsigned int pool_index(uint8_t type, void *block);
+
+// sizes the pools for the level's map and allocates them empty, false when they don't fit the heap.
+// high water marks are kept
+bool pool_setup(const uint8_t *map, unsigned int map_size);
+
+// frees the pools of the last level
+void pool_release(void);
+
+// the entity tables (simple_mover, chomper, poof...) hold pointers into the pools in update order.
+// removing an entity leaves a NULL tombstone that loops over the table skip, so removal is O(1)
+// and doesn't move anything under a loop that's running. tombstones at the end of a table are
+// trimmed right away, the rest are swept out by sweep_entity_tables once a step
+extern bool entity_tombstones;
+
+#define trim_table(table, count) \
+    while ((count) && !(table)[(count) - 1]) { (count)--; }
+
+#define sweep_table(table, count) { \
+    uint8_t sweep_from, sweep_to = 0; \
+    for (sweep_from = 0; sweep_from < (count); sweep_from++) { \
+        if ((table)[sweep_from]) { (table)[sweep_to++] = (table)[sweep_from]; } \
+    } \
+    (count) = sweep_to; \
+}
+
+// sets the tombstone of entry i, which must be in the table
+#define clear_table_entry(table, count, i) { \
+    (table)[i] = NULL; \
+    trim_table(table, count); \
+    if ((i) < (count)) { entity_tombstones = true; } \
+}
+
+void sweep_entity_tables(void);
+
+#endif
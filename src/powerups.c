@@ -26,13 +26,13 @@ void add_mushroom_1up(uint8_t *spawing_tile) {
 void add_mushroom(uint8_t *spawing_tile) {
     simple_move_t *shroom = add_simple_mover(spawing_tile);
 
-    shroom->hitbox.width = 15;
-    shroom->hitbox.height = 15;
-    shroom->y -= TILE_HEIGHT;
-    if (oiram.x < shroom->x) {
-        shroom->vx = 2;
+    movers.hitbox[shroom->slot].width = 15;
+    movers.hitbox[shroom->slot].height = 15;
+    movers.y[shroom->slot] -= TILE_HEIGHT;
+    if (oiram.x < movers.x[shroom->slot]) {
+        movers.vx[shroom->slot] = 2;
     } else {
-        shroom->vx = -2;
+        movers.vx[shroom->slot] = -2;
     }
     shroom->type = MUSHROOM_TYPE;
 }
@@ -40,24 +40,24 @@ void add_mushroom(uint8_t *spawing_tile) {
 void add_star(uint8_t *spawing_tile) {
     simple_move_t *star = add_simple_mover(spawing_tile);
 
-    star->hitbox.width = 15;
-    star->hitbox.height = 15;
-    star->y -= TILE_HEIGHT;
-    if (oiram.x < star->x) {
-        star->vx = 2;
+    movers.hitbox[star->slot].width = 15;
+    movers.hitbox[star->slot].height = 15;
+    movers.y[star->slot] -= TILE_HEIGHT;
+    if (oiram.x < movers.x[star->slot]) {
+        movers.vx[star->slot] = 2;
     } else {
-        star->vx = -2;
+        movers.vx[star->slot] = -2;
     }
     star->type = STAR_TYPE;
-    star->is_bouncer = true;
+    movers.is_bouncer[star->slot] = true;
 }
 
 void add_fire_flower(uint8_t *spawing_tile) {
     simple_move_t *flower = add_simple_mover(spawing_tile);
 
-    flower->hitbox.width = 15;
-    flower->hitbox.height = 15;
-    flower->y -= TILE_HEIGHT;
+    movers.hitbox[flower->slot].width = 15;
+    movers.hitbox[flower->slot].height = 15;
+    movers.y[flower->slot] -= TILE_HEIGHT;
     flower->type = FIRE_FLOWER_TYPE;
 }
 
@@ -0,0 +1,352 @@
+#include "platform.h"
+#include "debug.h"
+
+#if !TARGET_PRIZM
+#include <stdint.h>
+#endif
+
+#include "fileioc.h"
+#include "keypadc.h"
+
+#include "defines.h"
+#include "loadscreen.h"
+#include "replay.h"
+
+// the log is a stream of 3 byte records, multi byte values are little endian:
+//   [key mask] [tick delta] [repeat 1-255]     a run of identical frames
+//   [REPLAY_LEVEL] 0 0 [level header]          start of a level
+//   [REPLAY_TICKS] 0 0 [ticks, 4 bytes]        sets the tick base, used for large deltas
+//   [REPLAY_END] 0 0                           end of a level
+// level header: pack, level, pack var name (9 bytes), progress, coins, lives, flags, score (4 bytes)
+enum replay_records {
+    REPLAY_LEVEL=1,
+    REPLAY_TICKS,
+    REPLAY_END
+};
+
+#define REPLAY_LEVEL_SIZE 19
+#define REPLAY_MAX_SIZE 8192
+
+uint8_t replay_mode = REPLAY_OFF;
+const char replay_name[] = "OiramR";
+
+static uint8_t replay_data[REPLAY_MAX_SIZE];
+static uint8_t *replay_play_data;
+static unsigned int replay_size;
+static unsigned int replay_pos;
+static unsigned int replay_level_start;
+static bool replay_overflow;
+
+// current run of identical frames, and the tick base the deltas apply to
+static uint8_t run_mask;
+static uint8_t run_delta;
+static uint8_t run_repeat;
+static uint8_t frame_mask;
+static int frame_ticks;
+
+extern bool keyDown_fast(unsigned char keyCode);
+extern uint8_t *get_pack_pointer(ti_var_t slot);
+
+static void put_u32(uint8_t *data, uint32_t value) {
+    data[0] = (uint8_t)value;
+    data[1] = (uint8_t)(value >> 8);
+    data[2] = (uint8_t)(value >> 16);
+    data[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *data) {
+    return data[0] | (data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint8_t *write_record(uint8_t type, uint8_t delta, uint8_t repeat, unsigned int extra) {
+    uint8_t *record = &replay_data[replay_size];
+    if (replay_overflow || replay_size + 3 + extra > REPLAY_MAX_SIZE) {
+        replay_overflow = true;
+        return NULL;
+    }
+    record[0] = type;
+    record[1] = delta;
+    record[2] = repeat;
+    replay_size += 3 + extra;
+    return record + 3;
+}
+
+static void flush_frames(void) {
+    if (run_repeat) {
+        write_record(run_mask, run_delta, run_repeat, 0);
+        run_repeat = 0;
+    }
+}
+
+static void write_ticks(int ticks) {
+    uint8_t *data;
+    flush_frames();
+    if ((data = write_record(REPLAY_TICKS, 0, 0, 4))) {
+        put_u32(data, (uint32_t)ticks);
+    }
+    frame_ticks = ticks;
+}
+
+static void save_log(void) {
+    ti_var_t variable;
+    ti_CloseAll();
+    if ((variable = ti_Open(replay_name, "w", replay_size))) {
+        ti_Write(replay_data, 1, replay_size, variable);
+    }
+    ti_CloseAll();
+}
+
+// reads records up to the next run of frames, returns false at the end of the level
+static bool next_frames(void) {
+    while (replay_pos + 3 <= replay_size) {
+        uint8_t *record = &replay_play_data[replay_pos];
+        replay_pos += 3;
+
+        if (record[2]) {
+            run_mask = record[0];
+            run_delta = record[1];
+            run_repeat = record[2];
+            return true;
+        }
+
+        switch (record[0]) {
+            case REPLAY_TICKS:
+                frame_ticks = (int)get_u32(record + 3);
+                replay_pos += 4;
+                break;
+            case REPLAY_LEVEL:
+            case REPLAY_END:
+                replay_pos -= 3;
+                return false;
+        }
+    }
+    return false;
+}
+
+bool replay_begin_level(void) {
+    pack_info_t *pack;
+    uint8_t *data;
+
+    if (replay_mode == REPLAY_RECORD) {
+        pack = &pack_info[game.pack];
+        replay_level_start = replay_size;
+        run_repeat = 0;
+        if ((data = write_record(REPLAY_LEVEL, 0, 0, REPLAY_LEVEL_SIZE))) {
+            data[0] = game.pack;
+            data[1] = game.level;
+            strncpy((char*)&data[2], game.packVar, 8);
+            data[10] = 0;
+            data[11] = pack->progress;
+            data[12] = pack->coins;
+            data[13] = pack->lives;
+            data[14] = pack->flags;
+            put_u32(&data[15], pack->score);
+        }
+        return true;
+    }
+
+    if (replay_mode == REPLAY_PLAY) {
+        ti_var_t variable;
+
+        // load the whole log on the first level
+        if (!replay_play_data) {
+            ti_CloseAll();
+            if (!(variable = ti_Open(replay_name, "r", -1))) {
+                replay_mode = REPLAY_OFF;
+                return false;
+            }
+            replay_play_data = ti_GetDataPtr(variable);
+            replay_size = ti_GetSize(variable);
+            replay_pos = 0;
+            ti_CloseAll();
+        }
+
+        // skip anything left over from the previous level
+        while (replay_pos + 3 <= replay_size && (replay_play_data[replay_pos] != REPLAY_LEVEL || replay_play_data[replay_pos + 2])) {
+            if (replay_play_data[replay_pos] == REPLAY_TICKS && !replay_play_data[replay_pos + 2]) {
+                replay_pos += 4;
+            }
+            replay_pos += 3;
+        }
+        if (replay_pos + 3 + REPLAY_LEVEL_SIZE > replay_size) {
+            return false;
+        }
+
+        data = &replay_play_data[replay_pos + 3];
+        replay_pos += 3 + REPLAY_LEVEL_SIZE;
+
+        game.pack = data[0];
+        game.level = data[1];
+        memcpy(game.packVar, &data[2], 9);
+
+        pack = &pack_info[game.pack];
+        pack->progress = data[11];
+        pack->coins = data[12];
+        pack->lives = data[13];
+        pack->flags = data[14];
+        pack->score = get_u32(&data[15]);
+
+        run_repeat = 0;
+        return true;
+    }
+
+    return true;
+}
+
+void replay_end_level(void) {
+    if (replay_mode != REPLAY_RECORD) {
+        return;
+    }
+
+    flush_frames();
+    write_record(REPLAY_END, 0, 0, 0);
+
+    // drop a level that didn't fit and stop recording
+    if (replay_overflow) {
+        replay_size = replay_level_start;
+        replay_mode = REPLAY_OFF;
+    }
+
+    save_log();
+}
+
+uint8_t replay_keys(void) {
+    uint8_t keys = 0;
+
+    if (replay_mode == REPLAY_PLAY) {
+        if (!run_repeat && !next_frames()) {
+            // the log ran out mid level, leave it
+            run_mask = REPLAY_KEY_MENU;
+            run_delta = 4;
+            run_repeat = 1;
+        }
+        run_repeat--;
+        frame_ticks += run_delta;
+        return run_mask;
+    }
+
+    if (keyDown_fast(game.runKey))    { keys |= REPLAY_KEY_RUN;    }
+    if (keyDown_fast(game.duckKey))   { keys |= REPLAY_KEY_DUCK;   }
+    if (keyDown_fast(game.leftKey))   { keys |= REPLAY_KEY_LEFT;   }
+    if (keyDown_fast(game.rightKey))  { keys |= REPLAY_KEY_RIGHT;  }
+    if (keyDown_fast(game.attackKey)) { keys |= REPLAY_KEY_ATTACK; }
+    if (keyDown_fast(game.jumpKey))   { keys |= REPLAY_KEY_JUMP;   }
+    if (keyDown_fast(48))             { keys |= REPLAY_KEY_MENU;   }
+    if (keyDown_fast(game.pauseKey))  { keys |= REPLAY_KEY_PAUSE;  }
+
+    frame_mask = keys;
+    return keys;
+}
+
+int replay_ticks(int ticks) {
+    unsigned int delta;
+
+    if (replay_mode == REPLAY_PLAY) {
+        return frame_ticks;
+    }
+
+    if (replay_mode == REPLAY_RECORD) {
+        delta = (unsigned int)(ticks - frame_ticks);
+        if (delta > 255) {
+            write_ticks(ticks);
+            delta = 0;
+        }
+        frame_ticks = ticks;
+
+        // extend the current run or start a new one
+        if (run_repeat && run_repeat < 255 && run_mask == frame_mask && run_delta == delta) {
+            run_repeat++;
+        } else {
+            flush_frames();
+            run_mask = frame_mask;
+            run_delta = (uint8_t)delta;
+            run_repeat = 1;
+        }
+    }
+
+    return ticks;
+}
+
+// scripted input for replay_bench: run right holding run, jump for 12 of every 48 frames and throw fireballs
+static uint8_t bench_mask(unsigned int frame) {
+    uint8_t keys = REPLAY_KEY_RUN | REPLAY_KEY_RIGHT;
+    if (frame % 48 < 12) { keys |= REPLAY_KEY_JUMP;   }
+    if (frame % 20 == 0) { keys |= REPLAY_KEY_ATTACK; }
+    return keys;
+}
+
+bool replay_bench(const char *name, unsigned int frames) {
+    uint8_t *pack_data;
+    uint8_t num_levels;
+    uint8_t level;
+    uint8_t *data;
+    unsigned int frame;
+    ti_var_t slot;
+
+    // read the level count the same way set_level does
+    ti_CloseAll();
+    if (!(slot = ti_Open(name, "r", -1))) {
+        return false;
+    }
+    pack_data = get_pack_pointer(slot);
+    pack_data += strlen((char*)pack_data) + 1;
+    pack_data += strlen((char*)pack_data) + 1;
+    num_levels = *pack_data;
+    ti_CloseAll();
+
+    replay_size = 0;
+    replay_overflow = false;
+
+    for (level = 0; level < num_levels; level++) {
+        if ((data = write_record(REPLAY_LEVEL, 0, 0, REPLAY_LEVEL_SIZE))) {
+            memset(data, 0, REPLAY_LEVEL_SIZE);
+            data[1] = level;
+            strncpy((char*)&data[2], name, 8);
+            data[11] = num_levels;
+            data[13] = 99;
+            data[14] = FLAG_OIRAM_BIG | FLAG_OIRAM_FIRE;
+        }
+
+        // each frame is 4 ticks, as if running locked at 32 FPS. the frame after the last record
+        // leaves the level, so that one is part of the count too
+        run_repeat = 0;
+        for (frame = 1; frame < frames; frame++) {
+            frame_mask = bench_mask(frame);
+            if (run_repeat && run_repeat < 255 && run_mask == frame_mask) {
+                run_repeat++;
+            } else {
+                flush_frames();
+                run_mask = frame_mask;
+                run_delta = 4;
+                run_repeat = 1;
+            }
+        }
+        flush_frames();
+        write_record(REPLAY_END, 0, 0, 0);
+    }
+
+    if (replay_overflow || !num_levels) {
+        return false;
+    }
+
+    // play it back straight from memory
+    replay_play_data = replay_data;
+    replay_pos = 0;
+    replay_mode = REPLAY_PLAY;
+    return true;
+}
+
+int replay_sync_ticks(int ticks) {
+    if (replay_mode == REPLAY_PLAY) {
+        if (!run_repeat) {
+            next_frames();
+        }
+        return frame_ticks;
+    }
+
+    if (replay_mode == REPLAY_RECORD) {
+        write_ticks(ticks);
+    }
+
+    return ticks;
+}
@@ -0,0 +1,43 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#if !TARGET_PRIZM
+#include <stdint.h>
+#endif
+
+// input recording and replay, the gameplay keys and the RTC ticks the timer logic consumes are
+// logged once per frame so a session can be played back exactly, independent of frame timing
+enum replay_modes {
+    REPLAY_OFF=0,
+    REPLAY_RECORD,
+    REPLAY_PLAY
+};
+
+// gameplay key bits, in the order handler_keypad reads them
+#define REPLAY_KEY_RUN    (1<<0)
+#define REPLAY_KEY_DUCK   (1<<1)
+#define REPLAY_KEY_LEFT   (1<<2)
+#define REPLAY_KEY_RIGHT  (1<<3)
+#define REPLAY_KEY_ATTACK (1<<4)
+#define REPLAY_KEY_JUMP   (1<<5)
+#define REPLAY_KEY_MENU   (1<<6)
+#define REPLAY_KEY_PAUSE  (1<<7)
+
+extern uint8_t replay_mode;
+extern const char replay_name[];
+
+// starts the level in game.pack / game.level, or when playing loads it from the log. returns false at the end of a replay
+bool replay_begin_level(void);
+void replay_end_level(void);
+
+// per frame inputs: call replay_keys once and then replay_ticks once every frame
+uint8_t replay_keys(void);
+int replay_ticks(int ticks);
+
+// resyncs the tick base, such as at the start of a level
+int replay_sync_ticks(int ticks);
+
+// sets up playback of every level in a pack for a fixed number of frames of scripted input, for benchmarking
+bool replay_bench(const char *name, unsigned int frames);
+
+#endif
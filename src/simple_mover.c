@@ -17,65 +17,74 @@
 #include "tile_handlers.h"
 #include "events.h"
 #include "images.h"
+#include "pool.h"
+#include "grid.h"
+#include "enemies.h"
 
 simple_move_t *simple_mover[MAX_SIMPLE_MOVERS];
+mover_state_t movers;
 uint8_t num_simple_movers = 0;
 uint8_t simple_mover_type;
 
 simple_move_t *add_simple_mover(uint8_t *spawing_tile) {
     simple_move_t *mover;
     unsigned int x, y;
-
-    if (num_simple_movers > MAX_SIMPLE_MOVERS - 1) {
-        remove_simple_mover(0);
+    uint16_t s;
+
+    // full of live movers, drop the oldest
+    if (num_simple_movers > MAX_SIMPLE_MOVERS - 1 || pool_full(POOL_SIMPLE_MOVERS)) {
+        sweep_table(simple_mover, num_simple_movers);
+        if (num_simple_movers > MAX_SIMPLE_MOVERS - 1 || pool_full(POOL_SIMPLE_MOVERS)) {
+            remove_simple_mover(0);
+            sweep_table(simple_mover, num_simple_movers);
+        }
+        invalidate_grids();
     }
 
     tile_to_abs_xy_pos(spawing_tile, &x, &y);
 
-    mover = simple_mover[num_simple_movers] = malloc(sizeof(simple_move_t));
-
-    mover->vy = 0;
-    mover->vx = 0;
-    mover->x = x;
-    mover->y = y;
-    mover->bumped = false;
-    mover->smart = false;
-    mover->is_bouncer = false;
-    mover->is_flyer = false;
+    mover = simple_mover[num_simple_movers] = pool_alloc(POOL_SIMPLE_MOVERS);
+    mover->slot = s = pool_index(POOL_SIMPLE_MOVERS, mover);
+
+    movers.vy[s] = 0;
+    movers.vx[s] = 0;
+    movers.x[s] = x;
+    movers.y[s] = y;
+    movers.bumped[s] = false;
+    movers.smart[s] = false;
+    movers.is_bouncer[s] = false;
+    movers.is_flyer[s] = false;
     mover->counter = -1;
     mover->score_counter = 0;
     mover->fly_counter = 0;
+    mover->spawn = spawning;
+    grid_added(GRID_SIMPLE_MOVERS, num_simple_movers);
     num_simple_movers++;
     return mover;
 }
 
 void remove_simple_mover(uint8_t i) {
-    simple_move_t *mover = simple_mover[i];
-    uint8_t num_simple_movers_less;
+    simple_move_t *mover;
 
-    if (!num_simple_movers) {
+    if (i >= num_simple_movers || !(mover = simple_mover[i])) {
         return;
     }
 
-    num_simple_movers_less = num_simple_movers--;
-
-    for(; i < num_simple_movers_less; i++) {
-        simple_mover[i] = simple_mover[i+1];
-    }
-
-    free(mover);
+    clear_table_entry(simple_mover, num_simple_movers, i);
+    pool_free(POOL_SIMPLE_MOVERS, mover);
 }
 
 void simple_move_handler(simple_move_t *this) {
     int tmp_x, tmp_y;
+    uint16_t s = this->slot;
 
-    int new_y = this->y;
-    int new_x = this->x;
-    int tmp_vy = this->vy;
-    int tmp_vx = this->vx;
+    int new_y = movers.y[s];
+    int new_x = movers.x[s];
+    int tmp_vy = movers.vy[s];
+    int tmp_vx = movers.vx[s];
 
-    int add_right = this->hitbox.width;
-    int add_bottom = this->hitbox.height;
+    int add_right = movers.hitbox[s].width;
+    int add_bottom = movers.hitbox[s].height;
 
     bool test_right_bottom, test_left_bottom;
 
@@ -94,7 +103,7 @@ void simple_move_handler(simple_move_t *this) {
     test_left_bottom  = moveable_tile_left_bottom(tmp_x, tmp_y);
     test_right_bottom = moveable_tile_right_bottom(tmp_x + add_right, tmp_y);
 
-    if (!this->is_flyer) {
+    if (!movers.is_flyer[s]) {
 
         // if nothing below, start accelerating
         if (test_left_bottom || test_right_bottom) {
@@ -102,12 +111,12 @@ void simple_move_handler(simple_move_t *this) {
                 if (tmp_vy < 7) {
                     tmp_vy++;
                 }
-            } else if (this->smart) {
+            } else if (movers.smart[s]) {
                 if ((tmp_vx < 0 && test_left_bottom) || (tmp_vx >= 0 && test_right_bottom)) {
                     tmp_vx = -tmp_vx;
                 }
             }
-        } else if (this->is_bouncer) {
+        } else if (movers.is_bouncer[s]) {
             tmp_vy = -6;
         }
 
@@ -193,8 +202,8 @@ set_new_left_right:
         tmp_vx = -tmp_vx;
     }
 
-    this->x = new_x;
-    this->y = new_y;
-    this->vy = tmp_vy;
-    this->vx = tmp_vx;
+    movers.x[s] = new_x;
+    movers.y[s] = new_y;
+    movers.vy[s] = tmp_vy;
+    movers.vx[s] = tmp_vx;
 }
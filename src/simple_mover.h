@@ -13,20 +13,35 @@
 
 #define MAX_SIMPLE_MOVERS 252
 
+// fireballs move with simple movers of their own
+#define MAX_FIREBALL_MOVERS 25
+
+// the position, velocity, hitbox and flags of every mover, kept in arrays by slot so the checks
+// that scan many movers read only the fields they test. simple movers have the first
+// MAX_SIMPLE_MOVERS slots and fireball movers the rest, one per pool block
+#define MAX_MOVER_SLOTS (MAX_SIMPLE_MOVERS + MAX_FIREBALL_MOVERS)
+
+typedef struct {
+    int x[MAX_MOVER_SLOTS], y[MAX_MOVER_SLOTS];     // x and y absolute posistions on screen
+    int8_t vy[MAX_MOVER_SLOTS];
+    int8_t vx[MAX_MOVER_SLOTS];
+    hitbox_t hitbox[MAX_MOVER_SLOTS];
+    bool bumped[MAX_MOVER_SLOTS];
+    bool smart[MAX_MOVER_SLOTS];
+    bool is_bouncer[MAX_MOVER_SLOTS];
+    bool is_flyer[MAX_MOVER_SLOTS];
+} mover_state_t;
+
+extern mover_state_t movers;
+
 typedef struct simple_move {
-    int x, y;      // x and y absolute posistions on screen
-    int8_t vy;
-    int8_t vx;
+    uint16_t slot;      // of the mover's state in movers
     uint8_t type;
-    hitbox_t hitbox;
-    bool bumped;
-    bool smart;
-    bool is_bouncer;
-    bool is_flyer;
     int8_t fly_counter;
     int8_t counter;
-    gfx_sprite_t *sprite;
     uint8_t score_counter;
+    gfx_sprite_t *sprite;
+    uint16_t spawn;     // see spawning in enemies.h
 } simple_move_t;
 
 enum simple_move_type {
@@ -19,8 +19,10 @@
 #include "oiram.h"
 #include "images.h"
 #include "lower.h"
+#include "pool.h"
+#include "grid.h"
 
-#define tile_y_loc(x) ((((unsigned int)(x) - (unsigned int)(tilemap.map)) / tilemap.width) * TILE_HEIGHT)
+#define tile_y_loc(x) (((unsigned int)((x) - tilemap.map) / tilemap.width) * TILE_HEIGHT)
 
 uint8_t move_side;
 bool force_jump;
@@ -498,28 +500,29 @@ poof_t *poof[MAX_POOFS];
 uint8_t num_poofs = 0;
 
 void remove_poof(uint8_t i) {
-    poof_t *free_me = poof[i];
-    uint8_t num_poofs_less;
+    poof_t *free_me;
 
-    if (!num_poofs) { return; }
-
-    num_poofs_less = num_poofs--;
-
-    for(; i < num_poofs_less; i++) {
-        poof[i] = poof[i+1];
+    if (i >= num_poofs || !(free_me = poof[i])) {
+        return;
     }
 
-    free(free_me);
+    clear_table_entry(poof, num_poofs, i);
+    pool_free(POOL_POOFS, free_me);
 }
 
 void add_poof(int x, int y) {
     poof_t *fluff;
 
-   if (num_poofs >= MAX_POOFS - 1) {
-        remove_poof(0);
+    // drop the oldest to make room
+    if (num_poofs >= MAX_POOFS - 1) {
+        sweep_table(poof, num_poofs);
+        if (num_poofs >= MAX_POOFS - 1) {
+            remove_poof(0);
+            sweep_table(poof, num_poofs);
+        }
     }
 
-    fluff = poof[num_poofs] = malloc(sizeof(poof_t));
+    fluff = poof[num_poofs] = pool_alloc(POOL_POOFS);
     num_poofs++;
     fluff->x = x;
     fluff->y = y;
@@ -528,23 +531,19 @@ void add_poof(int x, int y) {
 }
 
 void remove_fireball(uint8_t i) {
-    fireball_t *free_me = fireball[i];
-    uint8_t num_fireballs_less;
-
-    if (!num_fireballs) { return; }
+    fireball_t *free_me;
 
-    num_fireballs_less = num_fireballs--;
+    if (i >= num_fireballs || !(free_me = fireball[i])) {
+        return;
+    }
 
     if (free_me->mover->type == OIRAM_FIREBALL) {
         oiram.fireballs--;
     }
 
-    for(; i < num_fireballs_less; i++) {
-        fireball[i] = fireball[i+1];
-    }
-
-    free(free_me->mover);
-    free(free_me);
+    clear_table_entry(fireball, num_fireballs, i);
+    pool_free(POOL_FIREBALL_MOVERS, free_me->mover);
+    pool_free(POOL_FIREBALLS, free_me);
 }
 
 // add a fireball
@@ -553,36 +552,40 @@ void add_fireball(int x, int y, uint8_t dir, uint8_t type) {
     simple_move_t *mover;
 
     if (num_fireballs >= MAX_FIREBALLS - 1) {
-        return;
+        sweep_table(fireball, num_fireballs);
+        if (num_fireballs >= MAX_FIREBALLS - 1) {
+            return;
+        }
     }
 
-    ball = fireball[num_fireballs] = malloc(sizeof(fireball_t));
-    mover = ball->mover = malloc(sizeof(simple_move_t));
-    mover->x = x;
-    mover->y = y;
+    ball = fireball[num_fireballs] = pool_alloc(POOL_FIREBALLS);
+    mover = ball->mover = pool_alloc(POOL_FIREBALL_MOVERS);
+    mover->slot = MAX_SIMPLE_MOVERS + pool_index(POOL_FIREBALL_MOVERS, mover);
+    movers.x[mover->slot] = x;
+    movers.y[mover->slot] = y;
 
     // handle DOWN_RIGHT by default
-    mover->vy = 3;
-    mover->vx = 3;
+    movers.vy[mover->slot] = 3;
+    movers.vx[mover->slot] = 3;
 
     switch(dir) {
         case UP_LEFT:
-            mover->vx = -3;
-            mover->vy = -3;
+            movers.vx[mover->slot] = -3;
+            movers.vy[mover->slot] = -3;
             break;
         case UP_RIGHT:
-            mover->vy = -3;
+            movers.vy[mover->slot] = -3;
             break;
         case DOWN_LEFT:
-            mover->vx = -3;
+            movers.vx[mover->slot] = -3;
             break;
         default:
             break;
     }
-    mover->is_flyer = false;
-    mover->is_bouncer = true;
-    mover->hitbox.height = 7;
-    mover->hitbox.width = 7;
+    movers.is_flyer[mover->slot] = false;
+    movers.is_bouncer[mover->slot] = true;
+    movers.hitbox[mover->slot].height = 7;
+    movers.hitbox[mover->slot].width = 7;
     mover->type = type;
     ball->count = 127;
     num_fireballs++;
@@ -856,15 +859,22 @@ uint8_t num_bumped_tiles = 0;
 
 bumped_tile_t *add_bumped(uint8_t *tile, uint8_t dir) {
     bumped_tile_t *bump;
+    uint8_t found[GRID_MAX_FOUND];
     unsigned int x, y;
-    uint8_t i;
+    uint8_t i, num_found;
 
+    // drop the oldest to make room
     if (num_bumped_tiles > MAX_TILE_BUMPS - 1) {
-        remove_bumped_tile(0);
+        sweep_table(bumped_tile, num_bumped_tiles);
+        if (num_bumped_tiles > MAX_TILE_BUMPS - 1) {
+            remove_bumped_tile(0);
+            sweep_table(bumped_tile, num_bumped_tiles);
+        }
+        invalidate_grids();
     }
 
     tile_to_abs_xy_pos(tile, &x, &y);
-    bump = bumped_tile[num_bumped_tiles] = malloc(sizeof(bumped_tile_t));
+    bump = bumped_tile[num_bumped_tiles] = pool_alloc(POOL_BUMPED_TILES);
 
     switch(dir) {
         case TILE_BOTTOM:
@@ -884,31 +894,30 @@ bumped_tile_t *add_bumped(uint8_t *tile, uint8_t dir) {
     bump->tile_ptr = tile;
     bump->count = 2;
 
-    for(i = 0; i < num_simple_movers; i++) {
-        simple_move_t *cur = simple_mover[i];
+    num_found = query_grid(GRID_SIMPLE_MOVERS, bump->x, bump->x + 15, found);
+    for(i = 0; i < num_found; i++) {
+        simple_move_t *cur = simple_mover[found[i]];
 
         // check if we should bump it
-        if (gfx_CheckRectangleHotspot(bump->x, bump->y, 15, 15, cur->x, cur->y, cur->hitbox.width, cur->hitbox.height)) {
-            cur->vy -= 4;
-            cur->bumped = true;
+        if (cur && gfx_CheckRectangleHotspot(bump->x, bump->y, 15, 15, movers.x[cur->slot], movers.y[cur->slot], movers.hitbox[cur->slot].width, movers.hitbox[cur->slot].height)) {
+            movers.vy[cur->slot] -= 4;
+            movers.bumped[cur->slot] = true;
         }
     }
 
+    grid_added(GRID_BUMPED_TILES, num_bumped_tiles);
     num_bumped_tiles++;
 
     return bump;
 }
 
 void remove_bumped_tile(uint8_t i) {
-    bumped_tile_t *free_me = bumped_tile[i];
-    uint8_t num_bumped_tiles_less;
+    bumped_tile_t *free_me;
 
-    if (!num_bumped_tiles) {
+    if (i >= num_bumped_tiles || !(free_me = bumped_tile[i])) {
         return;
     }
 
-    num_bumped_tiles_less = num_bumped_tiles--;
-
     if (free_me->tile_ptr) {
         if (free_me->tile == TILE_VANISH) {
             *free_me->tile_ptr = TILE_EMPTY;
@@ -917,11 +926,8 @@ void remove_bumped_tile(uint8_t i) {
         }
     }
 
-    for(; i < num_bumped_tiles_less; i++) {
-        bumped_tile[i] = bumped_tile[i+1];
-    }
-
-    free(free_me);
+    clear_table_entry(bumped_tile, num_bumped_tiles, i);
+    pool_free(POOL_BUMPED_TILES, free_me);
 }
 
 #define MASK_PIPE_DOWN   (0)
@@ -1048,16 +1054,25 @@ uint8_t warp_tile_handler(uint8_t *tile) {
    TW - retracted!
  */
 
-uint8_t moveable_tile(int x, int y) {
+// tests the tile under a point and runs its handler. levels always use 16x16 tiles, so the tile
+// is found with shifts instead of the divisions in gfx_TilePtr, which are library calls on the SH4
+static inline uint8_t probe_tile(int x, int y, uint8_t side) {
     uint8_t *tile;
-    testing_side = 2;
+    testing_side = side;
 
     if (x < 0) { return false; }
     if (y < 0) { return true; }
-    tile = gfx_TilePtr(&tilemap, test_x = x, test_y = y);
+    if (y >= tilemap.height * TILE_HEIGHT) { return true; }
+    test_x = x;
+    test_y = y;
+    tile = tilemap.map + (unsigned)y / TILE_HEIGHT * tilemap.width + (unsigned)x / TILE_WIDTH;
     return (*tile_handler[*tile])(tile);
 }
 
+uint8_t moveable_tile(int x, int y) {
+    return probe_tile(x, y, TEST_NONE);
+}
+
 uint8_t solid_tile_handler(uint8_t *tile) {
     return 0;
 }
@@ -1067,31 +1082,17 @@ uint8_t empty_tile_handler(uint8_t *tile) {
 }
 
 void tile_to_abs_xy_pos(uint8_t *tile, unsigned int *x, unsigned int *y) {
-    unsigned int offset = (unsigned int)tile - (unsigned int)tilemap.map;
+    unsigned int offset = (unsigned int)(tile - tilemap.map);
     *y = (offset / tilemap.width) * TILE_HEIGHT;
     *x = (offset % tilemap.width) * TILE_WIDTH;
 }
 
 uint8_t moveable_tile_left_bottom(int x, int y) {
-	uint8_t *tile;
-	testing_side = 1;
-
-	if (x < 0) { return false; }
-	if (y < 0) { return true; }
-	if (y >= tilemap.height * tilemap.tile_height) return true;
-	tile = gfx_TilePtr(&tilemap, test_x = x, test_y = y);
-	return (*tile_handler[*tile])(tile);
+    return probe_tile(x, y, TEST_LEFT);
 }
 
 uint8_t moveable_tile_right_bottom(int x, int y) {
-	uint8_t *tile;
-	testing_side = 0;
-
-	if (x < 0) { return false; }
-	if (y < 0) { return true; }
-	if (y >= tilemap.height * tilemap.tile_height) return true;
-	tile = gfx_TilePtr(&tilemap, test_x = x, test_y = y);
-	return (*tile_handler[*tile])(tile);
+    return probe_tile(x, y, TEST_RIGHT);
 }
 
 void animate() {
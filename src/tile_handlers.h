@@ -118,7 +118,7 @@ void tile_to_abs_xy_pos(uint8_t *tile, unsigned int *x, unsigned int *y);
 
 // misc
 #define MAX_POOFS     11
-#define MAX_FIREBALLS 25
+#define MAX_FIREBALLS MAX_FIREBALL_MOVERS
 
 typedef struct {
     int x, y;